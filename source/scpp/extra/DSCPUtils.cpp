@@ -2,9 +2,15 @@
 // Not originally part of SCP but required for the D side to work
 
 #include "DUtils.h"
+#include "lib/json/json.h"
 #include "xdrpp/marshal.h"
 #include "xdr/Stellar-SCP.h"
+#include "scp/EnvelopeInbox.h"
 #include "scp/Slot.h"
+#include "util/BitSet.h"
+
+#include <algorithm>
+#include <iterator>
 
 using namespace xdr;
 using namespace stellar;
@@ -14,5 +20,265 @@ SCP* createSCP(SCPDriver* driver, NodeID nodeID, bool isValidator, SCPQuorumSet
     return new stellar::SCP(*driver, nodeID, isValidator, qSetLocal);
 }
 
-#define PUSHBACKINST3(T, V) template void push_back<T, V<T>>(V<T>&, T&);
-PUSHBACKINST3(Slot::HistoricalStatement, std::vector)
+EnvelopeInbox* createEnvelopeInbox()
+{
+    return new stellar::EnvelopeInbox();
+}
+
+void destroyEnvelopeInbox(EnvelopeInbox* inbox)
+{
+    delete inbox;
+}
+
+NodeIndex* createNodeIndex()
+{
+    return new stellar::NodeIndex();
+}
+
+void destroyNodeIndex(NodeIndex* index)
+{
+    delete index;
+}
+
+namespace
+{
+// an `EnvelopeTable` indexed by `index` with an envelope for each of `nodes`
+void fillEnvelopeTable(EnvelopeTable& envs, std::vector<NodeID> const& nodes)
+{
+    for (auto const& n : nodes)
+    {
+        SCPEnvelope env;
+        env.statement.nodeID = n;
+        envs.set(n, std::make_shared<SCPEnvelopeWrapper>(env));
+    }
+}
+}
+
+bool isLocalVBlocking(SCP* scp, NodeIndex* index,
+                      std::vector<NodeID> const& nodes)
+{
+    EnvelopeTable envs(*index);
+    fillEnvelopeTable(envs, nodes);
+    return LocalNode::isVBlocking(*scp->getLocalNode(), envs,
+                                  [](SCPStatement const&) { return true; });
+}
+
+bool isLocalQuorum(SCP* scp, NodeIndex* index, std::vector<NodeID> const& nodes,
+                   std::vector<SCPQuorumSet> const& qSets)
+{
+    EnvelopeTable envs(*index);
+    fillEnvelopeTable(envs, nodes);
+    std::map<NodeID, SCPQuorumSetPtr> byNode;
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        byNode[nodes[i]] = std::make_shared<SCPQuorumSet>(qSets[i]);
+    }
+    return LocalNode::isQuorum(
+        *scp->getLocalNode(), envs,
+        [&](SCPStatement const& st) -> SCPQuorumSetPtr const& {
+            return byNode[st.nodeID];
+        },
+        [](SCPStatement const&) { return true; });
+}
+
+void getEnvelopeTableNodes(NodeIndex* index,
+                           std::vector<SCPEnvelope> const& envelopes,
+                           uint32 counter, std::vector<NodeID>& order,
+                           std::vector<NodeID>& filtered)
+{
+    EnvelopeTable envs(*index);
+    for (auto const& env : envelopes)
+    {
+        envs.set(env.statement.nodeID,
+                 std::make_shared<SCPEnvelopeWrapper>(env));
+    }
+    for (auto const& entry : envs)
+    {
+        order.emplace_back(entry.first);
+    }
+    auto nodes = envs.filter([&](SCPStatement const& st) {
+        return st.pledges.prepare().ballot.counter >= counter;
+    });
+    for (size_t i = 0; nodes.nextSet(i); ++i)
+    {
+        filtered.emplace_back(index->getNode(i));
+    }
+}
+
+namespace stellar
+{
+// reaches the internals of the slots for the helpers below, like the
+// `TestSCP` of the tests of stellar-core
+class TestSCP
+{
+  public:
+    static std::set<SCPBallot>
+    getPrepareCandidates(SCP& scp, uint64 slotIndex, SCPStatement const& hint)
+    {
+        auto slot = scp.getSlot(slotIndex, false);
+        return slot->mBallotProtocol.getPrepareCandidates(hint);
+    }
+};
+}
+
+void getPrepareCandidates(SCP* scp, uint64 slotIndex, SCPStatement const& hint,
+                          std::set<SCPBallot>& candidates)
+{
+    candidates = TestSCP::getPrepareCandidates(*scp, slotIndex, hint);
+}
+
+std::string getJsonInfo(SCP* scp, size_t limit)
+{
+    return scp->getJsonInfo(limit).toStyledString();
+}
+
+size_t compareValueWrapperPtrSet(SCPDriver* driver,
+                                 std::vector<Value> const& values,
+                                 std::vector<unsigned char> const& ops)
+{
+    ValueWrapperPtrSet set;
+    std::set<ValueWrapperPtr, WrappedValuePtrComparator> ref;
+    for (size_t i = 0; i < ops.size(); i++)
+    {
+        auto value = driver->wrapValue(values[i]);
+        bool res, refRes;
+        switch (ops[i])
+        {
+        case 0:
+            res = set.insert(value);
+            refRes = ref.insert(value).second;
+            break;
+        case 1:
+            res = set.contains(value);
+            refRes = ref.count(value) != 0;
+            break;
+        case 2:
+            res = set.erase(value);
+            refRes = ref.erase(value) != 0;
+            break;
+        default:
+        {
+            // with the wrapper the set holds, if any
+            auto it = std::find_if(set.begin(), set.end(),
+                                   [&](ValueWrapperPtr const& v) {
+                                       return v->getValue() == values[i];
+                                   });
+            auto held = it == set.end() ? value : *it;
+            refRes = ref.erase(held) != 0;
+            res = set.erase(it == set.end() ? value : *it);
+            break;
+        }
+        }
+        if (res != refRes || set.size() != ref.size() ||
+            !std::equal(set.begin(), set.end(), ref.begin()))
+        {
+            return i;
+        }
+    }
+    return ops.size();
+}
+
+static bool sameBits(BitSet const& bitset, std::set<size_t> const& ref)
+{
+    std::vector<size_t> bits;
+    for (size_t i = 0; bitset.nextSet(i); ++i)
+    {
+        bits.push_back(i);
+    }
+    return bitset.count() == ref.size() && bitset.empty() == ref.empty() &&
+           std::equal(bits.begin(), bits.end(), ref.begin(), ref.end()) &&
+           (ref.empty() || (bitset.min() == *ref.begin() &&
+                            bitset.max() == *ref.rbegin()));
+}
+
+template <typename SetOp>
+static std::set<size_t> refSetOp(std::set<size_t> const& a,
+                                 std::set<size_t> const& b, SetOp op)
+{
+    std::set<size_t> res;
+    op(a.begin(), a.end(), b.begin(), b.end(),
+       std::inserter(res, res.end()));
+    return res;
+}
+
+size_t compareBitSets(std::vector<unsigned char> const& ops,
+                      std::vector<size_t> const& bits)
+{
+    typedef std::set<size_t>::const_iterator It;
+    typedef std::insert_iterator<std::set<size_t>> Out;
+    BitSet sets[2];
+    std::set<size_t> refs[2];
+    for (size_t i = 0; i < ops.size(); i++)
+    {
+        auto& set = sets[ops[i] & 1];
+        auto const& other = sets[(ops[i] & 1) ^ 1];
+        auto& ref = refs[ops[i] & 1];
+        auto const& otherRef = refs[(ops[i] & 1) ^ 1];
+        switch (ops[i] >> 1)
+        {
+        case 0:
+            set.set(bits[i]);
+            ref.insert(bits[i]);
+            break;
+        case 1:
+            set.unset(bits[i]);
+            ref.erase(bits[i]);
+            break;
+        case 2:
+            set |= other;
+            ref = refSetOp(ref, otherRef, std::set_union<It, It, Out>);
+            break;
+        case 3:
+            set &= other;
+            ref = refSetOp(ref, otherRef, std::set_intersection<It, It, Out>);
+            break;
+        case 4:
+            set -= other;
+            ref = refSetOp(ref, otherRef, std::set_difference<It, It, Out>);
+            break;
+        case 5:
+            set.inplaceSymmetricDifference(other);
+            ref = refSetOp(ref, otherRef,
+                           std::set_symmetric_difference<It, It, Out>);
+            break;
+        case 6:
+            set = other;
+            ref = otherRef;
+            break;
+        default:
+            set = BitSet(bits[i]);
+            ref.clear();
+            break;
+        }
+
+        auto const& a = sets[0];
+        auto const& b = sets[1];
+        auto const& refA = refs[0];
+        auto const& refB = refs[1];
+        auto refUnion = refSetOp(refA, refB, std::set_union<It, It, Out>);
+        auto refIntersection =
+            refSetOp(refA, refB, std::set_intersection<It, It, Out>);
+        auto refDifference =
+            refSetOp(refA, refB, std::set_difference<It, It, Out>);
+        auto refSymmetricDifference =
+            refSetOp(refA, refB, std::set_symmetric_difference<It, It, Out>);
+        if (!sameBits(a, refA) || !sameBits(b, refB) ||
+            (a == b) != (refA == refB) || (a != b) != (refA != refB) ||
+            a.isSubsetEq(b) != refDifference.empty() ||
+            b.isSubsetEq(a) !=
+                std::includes(refA.begin(), refA.end(), refB.begin(),
+                              refB.end()) ||
+            a.get(bits[i]) != (refA.count(bits[i]) != 0) ||
+            a.unionCount(b) != refUnion.size() ||
+            a.intersectionCount(b) != refIntersection.size() ||
+            a.differenceCount(b) != refDifference.size() ||
+            a.symmetricDifferenceCount(b) != refSymmetricDifference.size() ||
+            !sameBits(a | b, refUnion) || !sameBits(a & b, refIntersection) ||
+            !sameBits(a - b, refDifference) ||
+            !sameBits(a.symmetricDifference(b), refSymmetricDifference))
+        {
+            return i;
+        }
+    }
+    return ops.size();
+}
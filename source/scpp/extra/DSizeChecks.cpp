@@ -19,6 +19,7 @@
 #include "xdrpp/types.h"
 #include "xdr/Stellar-SCP.h"
 #include "xdr/Stellar-types.h"
+#include "scp/EnvelopeInbox.h"
 #include "scp/Slot.h"
 #include "scp/SCPDriver.h"
 #include "crypto/ByteSlice.h"
@@ -67,3 +68,11 @@ CPPSIZEOF(SCPEnvelopeWrapper)
 CPPSIZEOF(ValueWrapper)
 CPPSIZEOF(ValueWrapperPtr)
 CPPSIZEOF(ValueWrapperPtrSet)
+CPPSIZEOF(NodeIndex)
+CPPSIZEOF(EnvelopeTable)
+CPPSIZEOF(BitSet)
+CPPSIZEOF(BallotTally)
+CPPSIZEOF(ValuePool)
+CPPSIZEOF(EnvelopeInbox)
+CPPSIZEOF(SlotStore)
+CPPSIZEOF(SlotArena)
@@ -49,6 +49,7 @@ opaque_vec<> XDRToOpaque(const stellar::SCPStatement& param)
 PUSHBACKINST2(const NodeID, xvector<NodeID>)
 PUSHBACKINST3(xvector<unsigned char>, std::vector)
 PUSHBACKINST3(unsigned char, std::vector)
+PUSHBACKINST3(unsigned long, std::vector)
 
 PUSHBACKINST1(unsigned char)
 // Workarounds for Dlang issue #20805
@@ -76,6 +77,7 @@ PUSHBACKINST1(SCPQuorumSet)
 PUSHBACKINST3(NodeID, std::vector)
 PUSHBACKINST3(SCPEnvelope, std::vector)
 PUSHBACKINST3(SCPQuorumSet, std::vector)
+PUSHBACKINST3(SCPEnvelopeWrapperPtr, std::vector)
 
 #define CPPSETFOREACHINST(T) template int cpp_set_foreach<T>(void*, void*, void*);
 CPPSETFOREACHINST(int)
@@ -83,6 +85,7 @@ CPPSETFOREACHINST(Value)
 CPPSETFOREACHINST(ValueWrapperPtr)
 CPPSETFOREACHINST(SCPBallot)
 CPPSETFOREACHINST(NodeID)
+CPPSETFOREACHINST(std::set<NodeID>)
 CPPSETFOREACHINST(unsigned int)
 
 #define CPPSETEMPTYINST(T) template bool cpp_set_empty<T>(const void*);
@@ -91,6 +94,7 @@ CPPSETEMPTYINST(Value)
 CPPSETEMPTYINST(ValueWrapperPtr)
 CPPSETEMPTYINST(SCPBallot)
 CPPSETEMPTYINST(NodeID)
+CPPSETEMPTYINST(std::set<NodeID>)
 CPPSETEMPTYINST(unsigned int)
 
 #define CPPUNORDEREDMAPASSIGNINST(K, V) template void cpp_unordered_map_assign<K, V>(void*, const K&, const V&);
@@ -144,6 +148,7 @@ CPPOBJECTINST(std::shared_ptr<SCPEnvelopeWrapper>);
 CPPOBJECTINST(std::set<int>);
 CPPOBJECTINST(std::set<Value>);
 CPPOBJECTINST(std::set<NodeID>);
+CPPOBJECTINST(std::set<std::set<NodeID>>);
 CPPOBJECTINST(std::set<SCPBallot>);
 CPPOBJECTINST(std::set<unsigned int>);
 
@@ -158,7 +163,10 @@ CPPVECINST(std::vector<unsigned long>);
 CPPVECINST(std::vector<unsigned long long>);
 CPPVECINST(std::vector<SCPQuorumSet>);
 CPPVECINST(std::vector<SCPEnvelope>);
-CPPVECINST(std::vector<Slot::HistoricalStatement>);
+CPPVECINST(std::vector<EnvelopeTable::Entry>);
+CPPVECINST(std::vector<SCPEnvelopeWrapperPtr>);
+CPPVECINST(std::vector<ValueWrapperPtr>);
+CPPVECINST(std::vector<SCP::EnvelopeState>);
 
 #define CPPUNIQUEPTRINST(T) CPPDEFAULTCTORINST(std::unique_ptr<T>) \
                             CPPDTORINST(std::unique_ptr<T>)        \
@@ -167,6 +175,7 @@ CPPUNIQUEPTRINST(SCPEnvelope);
 CPPUNIQUEPTRINST(SCPBallot);
 CPPUNIQUEPTRINST(Value);
 CPPUNIQUEPTRINST(stellar::BallotProtocol::SCPBallotWrapper);
+CPPUNIQUEPTRINST(HashState);
 
 #define CPPUNORDEREDMAPINST(K, V, id)   typedef std::unordered_map<K, V> ump_type_##id;  \
                                         CPPOBJECTINST(ump_type_##id);
@@ -178,7 +187,6 @@ CPPUNORDEREDMAPINST(int, int, 1)
 CPPMAPINST(int, int, 0)
 CPPMAPINST(NodeID, SCPEnvelope, 1)
 CPPMAPINST(uint64_t, std::shared_ptr<Slot>, 2)
-CPPMAPINST(stellar::NodeID, std::shared_ptr<SCPEnvelopeWrapper>, 3)
 
 #define CPPUNORDEREDMAPRANDHASHINST(K, V, id)   typedef std::unordered_map<K, V, stellar::RandHasher<K, std::hash<K > > > rand_map_type_##id;  \
                                 CPPOBJECTINST(rand_map_type_##id);
@@ -186,6 +194,8 @@ CPPMAPINST(stellar::NodeID, std::shared_ptr<SCPEnvelopeWrapper>, 3)
 
 CPPUNORDEREDMAPRANDHASHINST(int, int, 0);
 CPPUNORDEREDMAPRANDHASHINST(stellar::NodeID, stellar::QuorumTracker::NodeInfo, 1);
+CPPUNORDEREDMAPRANDHASHINST(stellar::NodeID, size_t, 2);
+CPPUNORDEREDMAPRANDHASHINST(stellar::NodeID, std::shared_ptr<SCPQuorumSet>, 3);
 
 // typedef std::set<ValueWrapperPtr, WrappedValuePtrComparator*> ValueWrapperPtrSet2;
 
@@ -414,6 +414,13 @@ bitset_equal(const bitset_t* b1, const bitset_t* b2)
         if (b1->array[k] != b2->array[k])
             return false;
     }
+    // the words past the end of the shorter bitset must be empty
+    const bitset_t* longer = b1->arraysize > b2->arraysize ? b1 : b2;
+    for (size_t k = minlength; k < longer->arraysize; ++k)
+    {
+        if (longer->array[k] != 0)
+            return false;
+    }
     return true;
 }
 
@@ -429,6 +436,14 @@ bitset_subseteq(const bitset_t* b1, const bitset_t* b2)
             return false;
         }
     }
+    // b1 has no bits past the end of b2
+    for (size_t k = minlength; k < b1->arraysize; ++k)
+    {
+        if (b1->array[k] != 0)
+        {
+            return false;
+        }
+    }
     return true;
 }
 
@@ -5,21 +5,78 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "quorum/QuorumTracker.h"
+#include <cstdint>
 #include <memory>
+#include <set>
 
 namespace stellar
 {
 class QuorumIntersectionChecker
 {
   public:
+    // `numThreads` is the number of threads searching for disjoint quorums,
+    // 0 for one per hardware thread
     static std::shared_ptr<QuorumIntersectionChecker>
     create(stellar::QuorumTracker::QuorumMap const& qmap,
-           bool quiet = false);
+           bool quiet = false, size_t numThreads = 1);
+
+    // Same as above, for a new version of the quorum map of `previous`. The
+    // checker keeps the graph of `previous` while no node joins or leaves,
+    // and the check builds on the last complete check of `previous`: a split
+    // stands while its nodes keep their quorum sets, and once intersection
+    // was found only the min-quorums including the few nodes that joined or
+    // changed their quorum set since are searched. `previous` can be null,
+    // and mustn't be checking.
+    static std::shared_ptr<QuorumIntersectionChecker>
+    create(std::shared_ptr<QuorumIntersectionChecker> const& previous,
+           stellar::QuorumTracker::QuorumMap const& qmap, bool quiet = false,
+           size_t numThreads = 1);
+
+    // Returns the groups of nodes (single validators and leaf inner sets)
+    // whose misbehaviour alone breaks quorum intersection, found by checking
+    // the network where the quorum set of each candidate group is made
+    // arbitrary. The candidates are checked on `numThreads` threads, 0 for
+    // one per hardware thread.
+    static std::set<std::set<NodeID>>
+    getIntersectionCriticalGroups(stellar::QuorumTracker::QuorumMap const& qmap,
+                                  size_t numThreads = 1);
 
     virtual ~QuorumIntersectionChecker(){};
     virtual bool networkEnjoysQuorumIntersection() const = 0;
     virtual size_t getMaxQuorumsFound() const = 0;
     virtual std::pair<std::vector<NodeID>, std::vector<NodeID>>
     getPotentialSplit() const = 0;
+
+    // Result of a check that can stop before it knows the answer
+    enum IntersectionResult
+    {
+        INTERSECTION_ENJOYED, // all the quorums intersect
+        INTERSECTION_SPLIT,   // found disjoint quorums, see getPotentialSplit
+        INTERSECTION_UNKNOWN  // cancelled or out of time
+    };
+
+    // Counters of the search for disjoint quorums since the checker was
+    // created, updated while it runs
+    struct Progress
+    {
+        uint64_t mCallsStarted;
+        uint64_t mMaxQuorumsSeen;
+        uint64_t mMinQuorumsSeen;
+        uint64_t mTerminations;
+        uint64_t mEarlyExits;
+    };
+
+    // Same as networkEnjoysQuorumIntersection, but gives up after
+    // `timeLimitMs` milliseconds (0 for no limit) or when `cancel` is called.
+    // networkEnjoysQuorumIntersection throws if the checker is cancelled.
+    virtual IntersectionResult
+    checkQuorumIntersection(uint64_t timeLimitMs) const = 0;
+
+    // Makes the running check and the next ones return INTERSECTION_UNKNOWN,
+    // can be called from any thread
+    virtual void cancel() const = 0;
+
+    // Returns the counters of the checks, can be called from any thread
+    virtual Progress getProgress() const = 0;
 };
 }
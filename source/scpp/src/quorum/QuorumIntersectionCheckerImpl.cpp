@@ -8,6 +8,10 @@
 #include "crypto/KeyUtils.h"
 #include "util/Logging.h"
 #include "util/Math.h"
+#include "util/XDROperators.h"
+
+#include <stdexcept>
+#include <thread>
 
 namespace
 {
@@ -136,7 +140,7 @@ TarjanSCCCalculator::scc(size_t i)
 size_t
 MinQuorumEnumerator::pickSplitNode() const
 {
-    std::vector<size_t>& inDegrees = mQic.mInDegrees;
+    std::vector<size_t>& inDegrees = mState.mInDegrees;
     inDegrees.assign(mQic.mGraph.size(), 0);
     assert(!mRemaining.empty());
     size_t maxNode = mRemaining.max();
@@ -187,24 +191,42 @@ MinQuorumEnumerator::maxCommit() const
 
 MinQuorumEnumerator::MinQuorumEnumerator(
     BitSet const& committed, BitSet const& remaining, BitSet const& scanSCC,
-    QuorumIntersectionCheckerImpl const& qic)
+    QuorumIntersectionCheckerImpl const& qic,
+    QuorumIntersectionCheckerImpl::SearchState& state, MinQuorumSearch* search,
+    size_t worker)
     : mCommitted(committed)
     , mRemaining(remaining)
     , mPerimeter(committed | remaining)
     , mScanSCC(scanSCC)
     , mQic(qic)
+    , mState(state)
+    , mSearch(search)
+    , mWorker(worker)
 {
 }
 
 bool
 MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
 {
-    mQic.mStats.mCallsStarted++;
+    // Another thread of a parallel search found disjoint quorums: the answer
+    // doesn't depend on this subproblem anymore. Or the check was cancelled
+    // or ran out of time, and its caller will ignore the result.
+    if ((mSearch && mSearch->stopped()) || mQic.interrupted())
+    {
+        return false;
+    }
+
+    mState.mStats.mCallsStarted++;
+
+    if ((mState.mStats.mCallsStarted % mQic.CHECKPOINT_INTERVAL) == 0)
+    {
+        mQic.checkpoint(mState);
+    }
 
     // Emit a progress meter every million calls.
-    if ((mQic.mStats.mCallsStarted & 0xfffff) == 0)
+    if ((mState.mStats.mCallsStarted & 0xfffff) == 0)
     {
-        mQic.mStats.log();
+        mState.mStats.log();
     }
     if (mQic.mLogTrace)
     {
@@ -215,10 +237,14 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
     // First early exit: we can avoid looking for further min-quorums if
     // we're committed to more than half the SCC plus 1: the other branches
     // of the search will find them instead, within the complement of a
-    // min-quorum they find (if they find any).
-    if (mCommitted.count() > maxCommit())
+    // min-quorum they find (if they find any). An incremental check doesn't
+    // enumerate those other branches, so it only exits once the complement
+    // of committed has no quorum left (see "Coda 3").
+    if (mCommitted.count() > maxCommit() &&
+        (!mQic.mIncremental ||
+         mQic.contractToMaximalQuorum(mScanSCC - mCommitted, mState).empty()))
     {
-        mQic.mStats.mEarlyExit1s++;
+        mState.mStats.mEarlyExit1s++;
         if (mQic.mLogTrace)
         {
             //CLOG_TRACE(SCP, "early exit 1, with committed={}", mCommitted);
@@ -235,10 +261,10 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
     {
         //CLOG_TRACE(SCP, "checking for quorum in committed={}", mCommitted);
     }
-    auto committedQuorum = mQic.contractToMaximalQuorum(mCommitted);
+    auto committedQuorum = mQic.contractToMaximalQuorum(mCommitted, mState);
     if (!committedQuorum.empty())
     {
-        if (mQic.isMinimalQuorum(committedQuorum))
+        if (mQic.isMinimalQuorum(committedQuorum, mState))
         {
             // Found a min-quorum. Examine it to see if
             // there's a disjoint quorum.
@@ -247,7 +273,7 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
                 //CLOG_TRACE(SCP, "early exit 3.1: minimal quorum={}",
                 //           committedQuorum);
             }
-            mQic.mStats.mEarlyExit31s++;
+            mState.mStats.mEarlyExit31s++;
             return hasDisjointQuorum(committedQuorum);
         }
         if (mQic.mLogTrace)
@@ -255,7 +281,7 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
             //CLOG_TRACE(SCP, "early exit 3.2: non-minimal quorum={}",
             //           committedQuorum);
         }
-        mQic.mStats.mEarlyExit32s++;
+        mState.mStats.mEarlyExit32s++;
         return false;
     }
 
@@ -266,7 +292,7 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
     {
         //CLOG_TRACE(SCP, "checking for quorum in perimeter={}", mPerimeter);
     }
-    auto extensionQuorum = mQic.contractToMaximalQuorum(mPerimeter);
+    auto extensionQuorum = mQic.contractToMaximalQuorum(mPerimeter, mState);
     if (!extensionQuorum.empty())
     {
         if (!mCommitted.isSubsetEq(extensionQuorum))
@@ -279,7 +305,7 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
                 //    "does not extend committed={}",
                 //    extensionQuorum, mPerimeter, mCommitted);
             }
-            mQic.mStats.mEarlyExit22s++;
+            mState.mStats.mEarlyExit22s++;
             return false;
         }
     }
@@ -291,14 +317,14 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
             //           "early exit 2.1: no extension quorum in perimeter={}",
             //           mPerimeter);
         }
-        mQic.mStats.mEarlyExit21s++;
+        mState.mStats.mEarlyExit21s++;
         return false;
     }
 
     // Principal termination condition: stop when remainder is empty.
     if (mRemaining.empty())
     {
-        mQic.mStats.mTerminations++;
+        mState.mStats.mTerminations++;
         if (mQic.mLogTrace)
         {
             //CLOG_TRACE(SCP, "remainder exhausted");
@@ -313,9 +339,23 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
         //CLOG_TRACE(SCP, "recursing into subproblems, split={}", split);
     }
     mRemaining.unset(split);
+    if (mSearch &&
+        mRemaining.count() >= MinQuorumSearch::MIN_SHARED_REMAINING)
+    {
+        // Parallel search: let any worker take the second subproblem, and
+        // take the first one.
+        BitSet committedWithSplit(mCommitted);
+        committedWithSplit.set(split);
+        mSearch->push(mWorker, committedWithSplit, mRemaining);
+        mState.mStats.mSecondRecursionsTaken++;
+        MinQuorumEnumerator childExcludingSplit(
+            mCommitted, mRemaining, mScanSCC, mQic, mState, mSearch, mWorker);
+        mState.mStats.mFirstRecursionsTaken++;
+        return childExcludingSplit.anyMinQuorumHasDisjointQuorum();
+    }
     MinQuorumEnumerator childExcludingSplit(mCommitted, mRemaining, mScanSCC,
-                                            mQic);
-    mQic.mStats.mFirstRecursionsTaken++;
+                                            mQic, mState, mSearch, mWorker);
+    mState.mStats.mFirstRecursionsTaken++;
     if (childExcludingSplit.anyMinQuorumHasDisjointQuorum())
     {
         if (mQic.mLogTrace)
@@ -327,27 +367,261 @@ MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum()
     }
     mCommitted.set(split);
     MinQuorumEnumerator childIncludingSplit(mCommitted, mRemaining, mScanSCC,
-                                            mQic);
-    mQic.mStats.mSecondRecursionsTaken++;
+                                            mQic, mState, mSearch, mWorker);
+    mState.mStats.mSecondRecursionsTaken++;
     return childIncludingSplit.anyMinQuorumHasDisjointQuorum();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Implementation of MinQuorumSearch
+////////////////////////////////////////////////////////////////////////////////
+
+MinQuorumSearch::MinQuorumSearch(BitSet const& scanSCC,
+                                 QuorumIntersectionCheckerImpl const& qic,
+                                 size_t numThreads)
+    : mScanSCC(scanSCC)
+    , mQic(qic)
+    , mPending(0)
+    , mStopped(false)
+    , mFound(false)
+    , mQueued(0)
+    , mWaiting(0)
+{
+    // The workers share the scan SCC: make sure its count is cached before
+    // they start reading it.
+    mScanSCC.count();
+    for (size_t i = 0; i < numThreads; ++i)
+    {
+        mWorkers.emplace_back(std::make_unique<Worker>());
+    }
+}
+
+void
+MinQuorumSearch::push(size_t worker, BitSet const& committed,
+                      BitSet const& remaining)
+{
+    auto& w = *mWorkers.at(worker);
+    mPending++;
+    {
+        std::lock_guard<std::mutex> lock(w.mMutex);
+        w.mSubproblems.emplace_back(Subproblem{committed, remaining});
+        mQueued++;
+    }
+    if (mWaiting != 0)
+    {
+        wake(false);
+    }
+}
+
+bool
+MinQuorumSearch::take(size_t worker, Subproblem& subproblem)
+{
+    // Own subproblems first, latest first: they're the smallest, and
+    // depth-first order keeps the deque short.
+    {
+        auto& w = *mWorkers.at(worker);
+        std::lock_guard<std::mutex> lock(w.mMutex);
+        if (!w.mSubproblems.empty())
+        {
+            subproblem = w.mSubproblems.back();
+            w.mSubproblems.pop_back();
+            mQueued--;
+            return true;
+        }
+    }
+    // Then steal the oldest (largest) subproblem of another worker.
+    for (size_t i = 1; i < mWorkers.size(); ++i)
+    {
+        auto& w = *mWorkers.at((worker + i) % mWorkers.size());
+        std::lock_guard<std::mutex> lock(w.mMutex);
+        if (!w.mSubproblems.empty())
+        {
+            subproblem = w.mSubproblems.front();
+            w.mSubproblems.pop_front();
+            mQueued--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+MinQuorumSearch::wait()
+{
+    // `push` checks `mWaiting` after counting its subproblem in `mQueued`,
+    // so either it notifies this worker or the predicate sees the subproblem.
+    // Interruptions are not notified: the wait is bounded to poll them.
+    std::unique_lock<std::mutex> lock(mIdleMutex);
+    mWaiting++;
+    mIdle.wait_for(lock, std::chrono::milliseconds(10), [this]() {
+        return mQueued != 0 || mPending == 0 || stopped();
+    });
+    mWaiting--;
+}
+
+void
+MinQuorumSearch::wake(bool all)
+{
+    {
+        // A worker between its predicate check and its wait holds the mutex.
+        std::lock_guard<std::mutex> lock(mIdleMutex);
+    }
+    if (all)
+    {
+        mIdle.notify_all();
+    }
+    else
+    {
+        mIdle.notify_one();
+    }
+}
+
+void
+MinQuorumSearch::stop()
+{
+    mStopped = true;
+    wake(true);
+}
+
+void
+MinQuorumSearch::work(size_t worker)
+{
+    auto& state = mWorkers.at(worker)->mState;
+    Subproblem subproblem;
+    while (!stopped() && !mQic.interrupted())
+    {
+        if (!take(worker, subproblem))
+        {
+            // Subproblems still being explored may push more.
+            if (mPending == 0)
+            {
+                break;
+            }
+            wait();
+            continue;
+        }
+        try
+        {
+            MinQuorumEnumerator mqe(subproblem.mCommitted,
+                                    subproblem.mRemaining, mScanSCC, mQic,
+                                    state, this, worker);
+            if (mqe.anyMinQuorumHasDisjointQuorum())
+            {
+                mFound = true;
+                stop();
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(mErrorMutex);
+            if (!mError)
+            {
+                mError = std::current_exception();
+            }
+            stop();
+        }
+        if (--mPending == 0)
+        {
+            wake(true);
+        }
+    }
+}
+
+bool
+MinQuorumSearch::anyMinQuorumHasDisjointQuorum()
+{
+    // The calling thread is the first worker.
+    std::vector<std::thread> threads;
+    try
+    {
+        for (size_t i = 1; i < mWorkers.size(); ++i)
+        {
+            threads.emplace_back(&MinQuorumSearch::work, this, i);
+        }
+    }
+    catch (...)
+    {
+        stop();
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        throw;
+    }
+    work(0);
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    // The stats of the workers are published already, or are by this
+    // checkpoint.
+    for (auto const& w : mWorkers)
+    {
+        mQic.checkpoint(w->mState);
+        mQic.mState.mStats.add(w->mState.mStats);
+        mQic.mState.mPublished.add(w->mState.mStats);
+    }
+    if (mError)
+    {
+        std::rethrow_exception(mError);
+    }
+    return mFound;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation of QuorumIntersectionChecker
 ////////////////////////////////////////////////////////////////////////////////
 
+QuorumIntersectionCheckerImpl::SearchState::SearchState()
+    : mCachedQuorums(MAX_CACHED_QUORUMS_SIZE)
+{
+}
+
 QuorumIntersectionCheckerImpl::QuorumIntersectionCheckerImpl(
     QuorumTracker::QuorumMap const& qmap,
-    bool quiet)
+    bool quiet, size_t numThreads)
     : mLogTrace(Logging::logTrace("SCP"))
+    , mNumThreads(numThreads)
+    , mCancelled(false)
+    , mTimedOut(false)
+    , mHasDeadline(false)
     , mQuiet(quiet)
+    , mIncremental(false)
     , mTSC(mGraph)
-    , mCachedQuorums(MAX_CACHED_QUORUMS_SIZE)
 {
+    if (mNumThreads == 0)
+    {
+        mNumThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
     buildGraph(qmap);
     buildSCCs();
 }
 
+QuorumIntersectionCheckerImpl::QuorumIntersectionCheckerImpl(
+    QuorumIntersectionCheckerImpl const& previous,
+    QuorumTracker::QuorumMap const& qmap, bool quiet, size_t numThreads)
+    : mLogTrace(previous.mLogTrace)
+    , mNumThreads(numThreads)
+    , mCancelled(false)
+    , mTimedOut(false)
+    , mHasDeadline(false)
+    , mQuiet(quiet)
+    , mKnown(previous.mKnown)
+    , mIncremental(false)
+    , mTSC(mGraph)
+{
+    if (mNumThreads == 0)
+    {
+        mNumThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    if (!updateGraph(previous, qmap))
+    {
+        buildGraph(qmap);
+        buildSCCs();
+    }
+}
+
 std::pair<std::vector<NodeID>, std::vector<NodeID>>
 QuorumIntersectionCheckerImpl::getPotentialSplit() const
 {
@@ -357,7 +631,90 @@ QuorumIntersectionCheckerImpl::getPotentialSplit() const
 size_t
 QuorumIntersectionCheckerImpl::getMaxQuorumsFound() const
 {
-    return mStats.mMaxQuorumsSeen;
+    return mState.mStats.mMaxQuorumsSeen;
+}
+
+void
+QuorumIntersectionCheckerImpl::cancel() const
+{
+    mCancelled = true;
+}
+
+QuorumIntersectionChecker::Progress
+QuorumIntersectionCheckerImpl::getProgress() const
+{
+    Progress res;
+    res.mCallsStarted = mProgress.mCallsStarted;
+    res.mMaxQuorumsSeen = mProgress.mMaxQuorumsSeen;
+    res.mMinQuorumsSeen = mProgress.mMinQuorumsSeen;
+    res.mTerminations = mProgress.mTerminations;
+    res.mEarlyExits = mProgress.mEarlyExits;
+    return res;
+}
+
+void
+QuorumIntersectionCheckerImpl::checkpoint(SearchState& state) const
+{
+    auto const& s = state.mStats;
+    auto const& p = state.mPublished;
+    mProgress.mCallsStarted += s.mCallsStarted - p.mCallsStarted;
+    mProgress.mMaxQuorumsSeen += s.mMaxQuorumsSeen - p.mMaxQuorumsSeen;
+    mProgress.mMinQuorumsSeen += s.mMinQuorumsSeen - p.mMinQuorumsSeen;
+    mProgress.mTerminations += s.mTerminations - p.mTerminations;
+    mProgress.mEarlyExits +=
+        (s.mEarlyExit1s + s.mEarlyExit21s + s.mEarlyExit22s +
+         s.mEarlyExit31s + s.mEarlyExit32s) -
+        (p.mEarlyExit1s + p.mEarlyExit21s + p.mEarlyExit22s +
+         p.mEarlyExit31s + p.mEarlyExit32s);
+    state.mPublished = s;
+
+    if (mHasDeadline && std::chrono::steady_clock::now() >= mDeadline)
+    {
+        mTimedOut = true;
+    }
+}
+
+void
+QuorumIntersectionCheckerImpl::noteKnownResult(IntersectionResult result,
+                                               BitSet const& nodes) const
+{
+    mKnown.mResult = result;
+    mKnown.mQuorumSets.clear();
+    for (size_t i = 0; nodes.nextSet(i); ++i)
+    {
+        mKnown.mQuorumSets.emplace(mBitNumPubKeys.at(i), mQuorumSets.at(i));
+    }
+    mKnown.mPotentialSplit = mPotentialSplit;
+}
+
+bool
+QuorumIntersectionCheckerImpl::isKnown(size_t node) const
+{
+    auto known = mKnown.mQuorumSets.find(mBitNumPubKeys.at(node));
+    if (known == mKnown.mQuorumSets.end())
+    {
+        return false;
+    }
+    auto const& qSet = mQuorumSets.at(node);
+    return qSet == known->second || *qSet == *known->second;
+}
+
+bool
+QuorumIntersectionCheckerImpl::knownSplitHolds() const
+{
+    if (mKnown.mResult != INTERSECTION_SPLIT)
+    {
+        return false;
+    }
+    for (auto const& known : mKnown.mQuorumSets)
+    {
+        auto i = mPubKeyBitNums.find(known.first);
+        if (i == mPubKeyBitNums.end() || !isKnown(i->second))
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
 void
@@ -376,6 +733,22 @@ QuorumIntersectionCheckerImpl::Stats::log() const
     //           mEarlyExit21s, mEarlyExit22s, mEarlyExit31s, mEarlyExit32s);
 }
 
+void
+QuorumIntersectionCheckerImpl::Stats::add(Stats const& other)
+{
+    mCallsStarted += other.mCallsStarted;
+    mFirstRecursionsTaken += other.mFirstRecursionsTaken;
+    mSecondRecursionsTaken += other.mSecondRecursionsTaken;
+    mMaxQuorumsSeen += other.mMaxQuorumsSeen;
+    mMinQuorumsSeen += other.mMinQuorumsSeen;
+    mTerminations += other.mTerminations;
+    mEarlyExit1s += other.mEarlyExit1s;
+    mEarlyExit21s += other.mEarlyExit21s;
+    mEarlyExit22s += other.mEarlyExit22s;
+    mEarlyExit31s += other.mEarlyExit31s;
+    mEarlyExit32s += other.mEarlyExit32s;
+}
+
 // This function is the innermost call in the checker and must be as fast
 // as possible. We spend almost all of our time in here.
 bool
@@ -455,13 +828,14 @@ QuorumIntersectionCheckerImpl::containsQuorumSliceForNode(BitSet const& bs,
 }
 
 bool
-QuorumIntersectionCheckerImpl::isAQuorum(BitSet const& nodes) const
+QuorumIntersectionCheckerImpl::isAQuorum(BitSet const& nodes,
+                                         SearchState& state) const
 {
-    bool* pRes = mCachedQuorums.maybeGet(nodes);
+    bool* pRes = state.mCachedQuorums.maybeGet(nodes);
     if (pRes == nullptr)
     {
-        bool result = !contractToMaximalQuorum(nodes).empty();
-        mCachedQuorums.put(nodes, result);
+        bool result = !contractToMaximalQuorum(nodes, state).empty();
+        state.mCachedQuorums.put(nodes, result);
         return result;
     }
     else
@@ -471,7 +845,8 @@ QuorumIntersectionCheckerImpl::isAQuorum(BitSet const& nodes) const
 }
 
 BitSet
-QuorumIntersectionCheckerImpl::contractToMaximalQuorum(BitSet nodes) const
+QuorumIntersectionCheckerImpl::contractToMaximalQuorum(BitSet nodes,
+                                                       SearchState& state) const
 {
     // Find greatest fixpoint of f(X) = {n ∈ X | containsQuorumSliceForNode(X,
     // n)}
@@ -508,7 +883,7 @@ QuorumIntersectionCheckerImpl::contractToMaximalQuorum(BitSet nodes) const
             }
             if (!filtered.empty())
             {
-                ++mStats.mMaxQuorumsSeen;
+                ++state.mStats.mMaxQuorumsSeen;
             }
             return filtered;
         }
@@ -517,12 +892,13 @@ QuorumIntersectionCheckerImpl::contractToMaximalQuorum(BitSet nodes) const
 }
 
 bool
-QuorumIntersectionCheckerImpl::isMinimalQuorum(BitSet const& nodes) const
+QuorumIntersectionCheckerImpl::isMinimalQuorum(BitSet const& nodes,
+                                               SearchState& state) const
 {
 #ifndef NDEBUG
     // We should only be called with a quorum, such that contracting to its
     // maximum doesn't do anything. This is a slightly expensive check.
-    assert(contractToMaximalQuorum(nodes) == nodes);
+    assert(contractToMaximalQuorum(nodes, state) == nodes);
 #endif
 
     BitSet minQ = nodes;
@@ -534,7 +910,7 @@ QuorumIntersectionCheckerImpl::isMinimalQuorum(BitSet const& nodes) const
     for (size_t i = 0; nodes.nextSet(i); ++i)
     {
         minQ.unset(i);
-        if (isAQuorum(minQ))
+        if (isAQuorum(minQ, state))
         {
             // There's a subquorum with i removed: nodes isn't a minq.
             return false;
@@ -544,7 +920,7 @@ QuorumIntersectionCheckerImpl::isMinimalQuorum(BitSet const& nodes) const
     }
     // Tried every possible one-node-less subset, found no subquorums: this one
     // is minimal.
-    mStats.mMinQuorumsSeen++;
+    state.mStats.mMinQuorumsSeen++;
     return true;
 }
 
@@ -552,6 +928,9 @@ void
 QuorumIntersectionCheckerImpl::noteFoundDisjointQuorums(
     BitSet const& nodes, BitSet const& disj) const
 {
+    // Threads of a parallel search may find disjoint quorums at the same
+    // time, only one of the pairs is kept.
+    std::lock_guard<std::mutex> lock(mPotentialSplitMutex);
     mPotentialSplit.first.clear();
     mPotentialSplit.second.clear();
 
@@ -579,7 +958,7 @@ QuorumIntersectionCheckerImpl::noteFoundDisjointQuorums(
 bool
 MinQuorumEnumerator::hasDisjointQuorum(BitSet const& nodes) const
 {
-    BitSet disj = mQic.contractToMaximalQuorum(mScanSCC - nodes);
+    BitSet disj = mQic.contractToMaximalQuorum(mScanSCC - nodes, mState);
     if (!disj.empty())
     {
         mQic.noteFoundDisjointQuorums(nodes, disj);
@@ -652,6 +1031,7 @@ QuorumIntersectionCheckerImpl::buildGraph(QuorumTracker::QuorumMap const& qmap)
     mPubKeyBitNums.clear();
     mBitNumPubKeys.clear();
     mGraph.clear();
+    mQuorumSets.clear();
 
     for (auto const& pair : qmap)
     {
@@ -679,16 +1059,86 @@ QuorumIntersectionCheckerImpl::buildGraph(QuorumTracker::QuorumMap const& qmap)
             auto qb = convertSCPQuorumSet(*(pair.second.mQuorumSet));
             qb.log();
             mGraph.emplace_back(qb);
+            mQuorumSets.emplace_back(pair.second.mQuorumSet);
+        }
+    }
+    mState.mStats.mTotalNodes = mPubKeyBitNums.size();
+}
+
+bool
+QuorumIntersectionCheckerImpl::updateGraph(
+    QuorumIntersectionCheckerImpl const& previous,
+    QuorumTracker::QuorumMap const& qmap)
+{
+    size_t nNodes = 0;
+    for (auto const& pair : qmap)
+    {
+        if (pair.second.mQuorumSet)
+        {
+            if (previous.mPubKeyBitNums.find(pair.first) ==
+                previous.mPubKeyBitNums.end())
+            {
+                return false;
+            }
+            nNodes++;
+        }
+    }
+    if (nNodes != previous.mBitNumPubKeys.size())
+    {
+        return false;
+    }
+
+    // Same nodes, so same node numbers: only the quorum sets that changed
+    // convert to different QBitSets.
+    mBitNumPubKeys = previous.mBitNumPubKeys;
+    mPubKeyBitNums = previous.mPubKeyBitNums;
+    mQuorumSets.resize(nNodes);
+    for (auto const& pair : qmap)
+    {
+        if (pair.second.mQuorumSet)
+        {
+            mQuorumSets.at(mPubKeyBitNums.at(pair.first)) =
+                pair.second.mQuorumSet;
+        }
+    }
+    mGraph.clear();
+    bool changed = false;
+    for (size_t i = 0; i < nNodes; ++i)
+    {
+        auto const& qSet = mQuorumSets.at(i);
+        auto const& previousQSet = previous.mQuorumSets.at(i);
+        if (qSet == previousQSet || *qSet == *previousQSet)
+        {
+            mGraph.emplace_back(previous.mGraph.at(i));
+        }
+        else
+        {
+            auto qb = convertSCPQuorumSet(*qSet);
+            qb.log();
+            mGraph.emplace_back(qb);
+            changed = true;
         }
     }
-    mStats.mTotalNodes = mPubKeyBitNums.size();
+    mState.mStats.mTotalNodes = mPubKeyBitNums.size();
+
+    // Same graph, same SCCs.
+    if (changed)
+    {
+        buildSCCs();
+    }
+    else
+    {
+        mTSC.mSCCs = previous.mTSC.mSCCs;
+        mState.mStats.mNumSCCs = mTSC.mSCCs.size();
+    }
+    return true;
 }
 
 void
 QuorumIntersectionCheckerImpl::buildSCCs()
 {
     mTSC.calculateSCCs();
-    mStats.mNumSCCs = mTSC.mSCCs.size();
+    mState.mStats.mNumSCCs = mTSC.mSCCs.size();
 }
 
 // The definition of the function moved to the file,
@@ -704,6 +1154,29 @@ QuorumIntersectionCheckerImpl::nodeName(size_t node) const
 bool
 QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
 {
+    switch (checkQuorumIntersection(0))
+    {
+    case INTERSECTION_ENJOYED:
+        return true;
+    case INTERSECTION_SPLIT:
+        return false;
+    default:
+        throw std::runtime_error("quorum intersection check cancelled");
+    }
+}
+
+QuorumIntersectionChecker::IntersectionResult
+QuorumIntersectionCheckerImpl::checkQuorumIntersection(
+    uint64_t timeLimitMs) const
+{
+    mTimedOut = false;
+    mHasDeadline = timeLimitMs != 0;
+    if (mHasDeadline)
+    {
+        mDeadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(timeLimitMs);
+    }
+
     size_t nNodes = mPubKeyBitNums.size();
     if (!mQuiet)
     {
@@ -711,6 +1184,22 @@ QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
         //          nNodes);
     }
 
+    // The nodes of a split found by a previous check still form disjoint
+    // quorums.
+    if (knownSplitHolds())
+    {
+        //CLOG_DEBUG(SCP, "Reusing the split of the previous check");
+        std::lock_guard<std::mutex> lock(mPotentialSplitMutex);
+        mPotentialSplit = mKnown.mPotentialSplit;
+        return INTERSECTION_SPLIT;
+    }
+
+    BitSet allNodes(nNodes);
+    for (size_t i = 0; i < nNodes; ++i)
+    {
+        allNodes.set(i);
+    }
+
     // First stage: do a single pass over the SCCs searching for one with a
     // quorum (on which to focus second stage enumeration); also note and bypass
     // second stage exhaustive scan if there are _two_ such SCCs with quorums,
@@ -719,7 +1208,7 @@ QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
     BitSet scanSCC;
     for (auto const& scc : mTSC.mSCCs)
     {
-        auto q = contractToMaximalQuorum(scc);
+        auto q = contractToMaximalQuorum(scc, mState);
         if (!q.empty())
         {
             if (scanSCC.empty())
@@ -727,7 +1216,7 @@ QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
                 // This is the first SCC with a quorum, we'll make it the
                 // scan SCC.
                 scanSCC = scc;
-                mStats.mScanSCCSize = scanSCC.count();
+                mState.mStats.mScanSCCSize = scanSCC.count();
                 //CLOG_DEBUG(SCP, "Found scan SCC: {}", scc);
                 //CLOG_DEBUG(SCP, "Containing quorum: {}", q);
                 for (size_t i = 0; scanSCC.nextSet(i); ++i)
@@ -739,7 +1228,8 @@ QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
             {
                 //CLOG_DEBUG(SCP, "Found extra SCC: {}", scc);
                 //CLOG_DEBUG(SCP, "Containing quorum: {}", q);
-                noteFoundDisjointQuorums(contractToMaximalQuorum(scanSCC), q);
+                noteFoundDisjointQuorums(
+                    contractToMaximalQuorum(scanSCC, mState), q);
                 foundDisjoint = true;
                 break;
             }
@@ -764,19 +1254,92 @@ QuorumIntersectionCheckerImpl::networkEnjoysQuorumIntersection() const
             //CLOG_WARNING(SCP, "No quorums found in any SCC "
             //                  "(possible network halt)");
         }
-        return true;
+        checkpoint(mState);
+        noteKnownResult(INTERSECTION_ENJOYED, allNodes);
+        return INTERSECTION_ENJOYED;
     }
 
-    // Second stage: scan the scan-SCC powerset, potentially expensive.
-    if (!foundDisjoint)
+    // Second stage: scan the scan-SCC powerset, potentially expensive. After
+    // a check that found quorum intersection, only the subsets including a
+    // node that changed since, if there are few of them.
+    BitSet changed(nNodes);
+    mIncremental = false;
+    if (!foundDisjoint && mKnown.mResult == INTERSECTION_ENJOYED)
     {
-        BitSet committed;
+        for (size_t i = 0; scanSCC.nextSet(i); ++i)
+        {
+            if (!isKnown(i))
+            {
+                changed.set(i);
+            }
+        }
+        mIncremental = changed.count() <= MAX_INCREMENTAL_CHANGES;
+    }
+    std::vector<std::pair<BitSet, BitSet>> roots;
+    if (mIncremental)
+    {
+        //CLOG_DEBUG(SCP, "Checking the min-quorums of {} changed nodes",
+        //           changed.count());
         BitSet remaining = scanSCC;
-        MinQuorumEnumerator mqe(committed, remaining, scanSCC, *this);
-        foundDisjoint = mqe.anyMinQuorumHasDisjointQuorum();
-        mStats.log();
+        for (size_t i = 0; changed.nextSet(i); ++i)
+        {
+            BitSet committed;
+            committed.set(i);
+            remaining.unset(i);
+            roots.emplace_back(committed, remaining);
+        }
+    }
+    else
+    {
+        roots.emplace_back(BitSet(), scanSCC);
+    }
+    if (!foundDisjoint && mNumThreads > 1)
+    {
+        MinQuorumSearch search(scanSCC, *this, mNumThreads);
+        for (auto const& root : roots)
+        {
+            search.push(0, root.first, root.second);
+        }
+        foundDisjoint = search.anyMinQuorumHasDisjointQuorum();
+        mState.mStats.log();
+    }
+    else if (!foundDisjoint)
+    {
+        for (auto const& root : roots)
+        {
+            MinQuorumEnumerator mqe(root.first, root.second, scanSCC, *this,
+                                    mState);
+            if (mqe.anyMinQuorumHasDisjointQuorum())
+            {
+                foundDisjoint = true;
+                break;
+            }
+        }
+        mState.mStats.log();
     }
-    return !foundDisjoint;
+    // A split found before the check was interrupted is still a split.
+    bool complete = !interrupted();
+    checkpoint(mState);
+    if (foundDisjoint)
+    {
+        BitSet split(nNodes);
+        for (auto const* quorum :
+             {&mPotentialSplit.first, &mPotentialSplit.second})
+        {
+            for (auto const& node : *quorum)
+            {
+                split.set(mPubKeyBitNums.at(node));
+            }
+        }
+        noteKnownResult(INTERSECTION_SPLIT, split);
+        return INTERSECTION_SPLIT;
+    }
+    if (!complete)
+    {
+        return INTERSECTION_UNKNOWN;
+    }
+    noteKnownResult(INTERSECTION_ENJOYED, allNodes);
+    return INTERSECTION_ENJOYED;
 }
 
 bool
@@ -799,6 +1362,45 @@ pointsToCandidate(SCPQuorumSet const& p, NodeID const& candidate)
     return false;
 }
 
+// Returns `qset` where the nodes of `group` are part of every slice: they
+// are removed and count toward the threshold of the sets they were in.
+SCPQuorumSet
+trustingGroup(SCPQuorumSet const& qset, std::set<NodeID> const& group)
+{
+    SCPQuorumSet res;
+    uint32 met = 0;
+    for (auto const& k : qset.validators)
+    {
+        if (group.count(k) != 0)
+        {
+            ++met;
+        }
+        else
+        {
+            res.validators.emplace_back(k);
+        }
+    }
+    for (auto const& i : qset.innerSets)
+    {
+        auto inner = trustingGroup(i, group);
+        if (inner.threshold == 0)
+        {
+            ++met;
+        }
+        else
+        {
+            res.innerSets.emplace_back(std::move(inner));
+        }
+    }
+    if (met >= qset.threshold)
+    {
+        // Satisfied by the group alone: any set of nodes contains a slice.
+        return SCPQuorumSet();
+    }
+    res.threshold = qset.threshold - met;
+    return res;
+}
+
 void
 findCriticalityCandidates(SCPQuorumSet const& p,
                           std::set<std::set<NodeID>>& candidates, bool root)
@@ -829,6 +1431,90 @@ findCriticalityCandidates(SCPQuorumSet const& p,
     }
 }
 
+QuorumIntersectionCheckerImpl::QuorumIntersectionCheckerImpl(
+    QuorumIntersectionCheckerImpl const& base, std::set<NodeID> const& group)
+    : mLogTrace(base.mLogTrace)
+    , mNumThreads(1)
+    , mCancelled(false)
+    , mTimedOut(false)
+    , mHasDeadline(false)
+    , mQuiet(true)
+    , mBitNumPubKeys(base.mBitNumPubKeys)
+    , mPubKeyBitNums(base.mPubKeyBitNums)
+    , mQuorumSets(base.mQuorumSets)
+    , mIncremental(false)
+    , mTSC(mGraph)
+{
+    size_t baseSize = mBitNumPubKeys.size();
+    BitSet groupBits;
+    BitSet dependents;
+    for (auto const& node : group)
+    {
+        auto i = mPubKeyBitNums.find(node);
+        if (i == mPubKeyBitNums.end())
+        {
+            size_t n = mBitNumPubKeys.size();
+            mPubKeyBitNums.insert(std::make_pair(node, n));
+            mBitNumPubKeys.emplace_back(node);
+            groupBits.set(n);
+            for (size_t j = 0; j < baseSize; ++j)
+            {
+                if (pointsToCandidate(*mQuorumSets[j], node))
+                {
+                    dependents.set(j);
+                }
+            }
+        }
+        else
+        {
+            groupBits.set(i->second);
+            for (size_t j = 0; j < baseSize; ++j)
+            {
+                if (base.mGraph[j].mAllSuccessors.get(i->second))
+                {
+                    dependents.set(j);
+                }
+            }
+        }
+    }
+
+    // The members of the group get the fickle quorum set, they are not
+    // counted among the nodes depending on it. As they agree with anyone,
+    // they are part of every slice of the dependents: two quorums of the
+    // dependents only need to intersect outside of the group.
+    dependents -= groupBits;
+    auto fickle = std::make_shared<SCPQuorumSet>();
+    fickle->threshold = 1;
+    for (size_t i = 0; dependents.nextSet(i); ++i)
+    {
+        fickle->validators.emplace_back(mBitNumPubKeys[i]);
+    }
+    mQuorumSets.resize(mBitNumPubKeys.size());
+
+    QBitSet fickleBits = convertSCPQuorumSet(*fickle);
+    mGraph.reserve(mBitNumPubKeys.size());
+    for (size_t i = 0; i < mBitNumPubKeys.size(); ++i)
+    {
+        if (groupBits.get(i))
+        {
+            mQuorumSets[i] = fickle;
+            mGraph.emplace_back(fickleBits);
+        }
+        else if (dependents.get(i))
+        {
+            mQuorumSets[i] = std::make_shared<SCPQuorumSet>(
+                trustingGroup(*mQuorumSets[i], group));
+            mGraph.emplace_back(convertSCPQuorumSet(*mQuorumSets[i]));
+        }
+        else
+        {
+            mGraph.emplace_back(base.mGraph[i]);
+        }
+    }
+    mState.mStats.mTotalNodes = mBitNumPubKeys.size();
+    buildSCCs();
+}
+
 std::string
 groupString(std::set<NodeID> const& group)
 {
@@ -853,8 +1539,126 @@ namespace stellar
 {
 std::shared_ptr<QuorumIntersectionChecker>
 QuorumIntersectionChecker::create(QuorumTracker::QuorumMap const& qmap,
-                                  bool quiet)
+                                  bool quiet, size_t numThreads)
 {
-    return std::make_shared<QuorumIntersectionCheckerImpl>(qmap, quiet);
+    return std::make_shared<QuorumIntersectionCheckerImpl>(qmap, quiet,
+                                                           numThreads);
+}
+
+std::shared_ptr<QuorumIntersectionChecker>
+QuorumIntersectionChecker::create(
+    std::shared_ptr<QuorumIntersectionChecker> const& previous,
+    QuorumTracker::QuorumMap const& qmap, bool quiet, size_t numThreads)
+{
+    if (!previous)
+    {
+        return create(qmap, quiet, numThreads);
+    }
+    return std::make_shared<QuorumIntersectionCheckerImpl>(
+        static_cast<QuorumIntersectionCheckerImpl const&>(*previous), qmap,
+        quiet, numThreads);
+}
+
+std::set<std::set<NodeID>>
+QuorumIntersectionChecker::getIntersectionCriticalGroups(
+    QuorumTracker::QuorumMap const& qmap, size_t numThreads)
+{
+    // We're going to search for "intersection-critical" groups, by considering
+    // each SCPQuorumSet S that (a) has no innerSets of its own and (b) occurs
+    // as an innerSet of anyone in the qmap, along with every single validator.
+    // We then consider "fickle" versions of these groups: each member gets a
+    // quorum set satisfied by any single node outside of the group pointing
+    // to it, and is part of every slice of those nodes, modeling a group
+    // that agrees with anyone who depends on it. A group is critical if the
+    // network loses quorum intersection that way.
+    std::set<std::set<NodeID>> candidates;
+    for (auto const& k : qmap)
+    {
+        if (k.second.mQuorumSet)
+        {
+            findCriticalityCandidates(*k.second.mQuorumSet, candidates, true);
+        }
+    }
+
+    // The quorum sets are converted once, each candidate's checker copies
+    // the graph and only converts the fickle quorum set.
+    QuorumIntersectionCheckerImpl base(qmap, true);
+    std::vector<std::set<NodeID> const*> groups;
+    for (auto const& group : candidates)
+    {
+        groups.emplace_back(&group);
+    }
+    std::vector<char> critical(groups.size(), 0);
+
+    std::atomic<size_t> next(0);
+    std::atomic<bool> stopped(false);
+    std::mutex errorMutex;
+    std::exception_ptr error;
+    auto work = [&]() {
+        try
+        {
+            for (size_t i = next++; i < groups.size() && !stopped; i = next++)
+            {
+                //CLOG_DEBUG(SCP, "Examining node group for intersection-"
+                //                "criticality: {}", groupString(*groups[i]));
+                QuorumIntersectionCheckerImpl checker(base, *groups[i]);
+                critical[i] = !checker.networkEnjoysQuorumIntersection();
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error)
+            {
+                error = std::current_exception();
+            }
+            stopped = true;
+        }
+    };
+
+    if (numThreads == 0)
+    {
+        numThreads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    numThreads = std::min(numThreads, std::max<size_t>(groups.size(), 1));
+    // The calling thread is the first worker.
+    std::vector<std::thread> threads;
+    try
+    {
+        for (size_t i = 1; i < numThreads; ++i)
+        {
+            threads.emplace_back(work);
+        }
+    }
+    catch (...)
+    {
+        stopped = true;
+        for (auto& t : threads)
+        {
+            t.join();
+        }
+        throw;
+    }
+    work();
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+
+    std::set<std::set<NodeID>> res;
+    for (size_t i = 0; i < groups.size(); ++i)
+    {
+        if (critical[i])
+        {
+            //CLOG_WARNING(SCP, "Group is intersection-critical: {}",
+            //             groupString(*groups[i]));
+            res.insert(*groups[i]);
+        }
+    }
+    return res;
 }
 }
@@ -349,6 +349,48 @@
 //
 // Remaining details of the implementation are noted as we go, but the above
 // explanation ought to give you a good idea what you're looking at.
+//
+//
+// Coda 2: parallel search
+// =======================
+//
+// The two recursive calls of the enumerator explore disjoint parts of the
+// powerset and only share read-only state (the graph), so the checker can
+// optionally hand the second branches of large subproblems to other threads
+// (see MinQuorumSearch): each thread has its own stats, scratch space and
+// cache of quorums, and the search stops as soon as any thread finds a pair
+// of disjoint quorums. Which pair is reported may then vary from a run to
+// another, but whether one exists does not.
+//
+//
+// Coda 3: incremental checks
+// ==========================
+//
+// A checker created from the checker of the previous version of the network
+// builds on its last complete check, which kept the quorum sets of the nodes
+// that decided it.
+//
+// A pair of disjoint quorums stays one as long as its nodes keep their quorum
+// sets: when they didn't change, the split is reported again without any
+// search.
+//
+// When the previous network enjoyed quorum intersection, a quorum of the new
+// one made of nodes that kept their quorum sets was a quorum of the previous
+// one too: nodes that left only make slices harder to satisfy. So any pair of
+// disjoint quorums includes a min-quorum with a "changed" node, which joined
+// or has a new quorum set, and the second stage only enumerates those: for
+// each changed node Cᵢ of the scan SCC, the subsets committed to Cᵢ within the
+// scan SCC minus C₁..Cᵢ₋₁. The other min-quorum of the pair may be the smaller
+// one, so the first early exit needs one more condition: that no quorum is
+// left in the complement of the committed set. The others hold as they are.
+// Each of these enumerations can cost about as much as a full one, so the
+// checker falls back to a full check beyond MAX_INCREMENTAL_CHANGES changed
+// nodes. With no changed node at all, the network still enjoys quorum
+// intersection without any search.
+//
+// The graph itself is polynomial to build, but its node numbers change when
+// nodes join or leave, so it is only kept from the previous checker while
+// they don't: only the quorum sets that changed are converted again.
 
 #include "QuorumIntersectionChecker.h"
 #include "crypto/StrKey.h"
@@ -357,11 +399,20 @@
 #include "xdr/Stellar-SCP.h"
 #include "xdr/Stellar-types.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+
 namespace
 {
 struct QBitSet;
 using QGraph = std::vector<QBitSet>;
 class QuorumIntersectionCheckerImpl;
+class MinQuorumSearch;
 
 // A QBitSet is the "fast" representation of a SCPQuorumSet. It includes both a
 // BitSet of its own nodes and a set of innerSets, along with a "successors"
@@ -411,53 +462,6 @@ struct TarjanSCCCalculator
     void scc(size_t i);
 };
 
-// A MinQuorumEnumerator is responsible to scanning the powerset of the SCC
-// we're considering, in a recursive bottom-up order, with a lot of early exits
-// described above. Each instance of MinQuorumEnumerator represents one call in
-// the recursion, and builds up to two sub-MinQuorumEnumerators for each of its
-// recursive cases.
-class MinQuorumEnumerator
-{
-
-    // Set of nodes "committed to" in this branch of the recurrence. In other
-    // words: set of nodes that this enumerator and its children will definitely
-    // include in every subset S of the powerset that they examine. This set
-    // will remain the same (omitting the split node) in one child, and expand
-    // (including the split node) in the other child.
-    BitSet mCommitted;
-
-    // Set of nodes that remain to be powerset-expanded in the recurrence. In
-    // other words: the part of the powerset that this enumerator and its
-    // children are responsible for is { committed ∪ r | r ∈ P(remaining) }.
-    // This set will strictly decrease (by the split node) in both children.
-    BitSet mRemaining;
-
-    // The set (committed ∪ remaining) which is a bound on the set of nodes in
-    // any set enumerated by this enumerator and its children.
-    BitSet mPerimeter;
-
-    // The initial value of mRemaining at the root of the search, representing
-    // the overall SCC we're considering subsets of.
-    BitSet const& mScanSCC;
-
-    // Checker that owns us, contains state of stats, graph, etc.
-    QuorumIntersectionCheckerImpl const& mQic;
-
-    // Select the next node in mRemaining to split recursive cases between.
-    size_t pickSplitNode() const;
-
-    // Size limit for mCommitted beyond which we should stop scanning.
-    size_t maxCommit() const;
-
-  public:
-    MinQuorumEnumerator(BitSet const& committed, BitSet const& remaining,
-                        BitSet const& scanSCC,
-                        QuorumIntersectionCheckerImpl const& qic);
-
-    bool hasDisjointQuorum(BitSet const& nodes) const;
-    bool anyMinQuorumHasDisjointQuorum();
-};
-
 // Quorum intersection checking is done by establishing a root
 // QuorumIntersectionChecker on a given QuorumMap. The QuorumIntersectionChecker
 // builds a QGraph of the nodes, uses TarjanSCCCalculator to calculate its SCCs,
@@ -481,14 +485,58 @@ class QuorumIntersectionCheckerImpl : public stellar::QuorumIntersectionChecker
         size_t mEarlyExit31s = {0};
         size_t mEarlyExit32s = {0};
         void log() const;
+        // adds the counters of the search of `other`
+        void add(Stats const& other);
+    };
+
+    // What a search modifies besides the potential split: its stats, and
+    // structures that are reused very often within the MinQuorumEnumerators,
+    // but never reentrantly / simultaneously, so we allocate them once and
+    // let the MQEs use them to avoid hammering on malloc. A parallel search
+    // has one for each of its threads.
+    struct SearchState
+    {
+        static const int MAX_CACHED_QUORUMS_SIZE = 0xffff;
+
+        SearchState();
+
+        Stats mStats;
+        // part of mStats added to the shared progress counters
+        Stats mPublished;
+        std::vector<size_t> mInDegrees;
+        stellar::RandomEvictionCache<BitSet, bool, BitSet::HashFunction>
+            mCachedQuorums;
     };
 
     // We use our own stats and a local cached flag to control tracing because
     // using the global metrics and log-partition lookups at a fine grain
     // actually becomes problematic CPU-wise.
-    mutable Stats mStats;
+    // `mState` is the state of the thread calling the checker.
+    mutable SearchState mState;
     bool mLogTrace;
 
+    // Number of threads scanning the powerset, 1 for a sequential search.
+    size_t mNumThreads;
+
+    // Set by `cancel`, or when the running check reaches `mDeadline`. The
+    // enumerators check the deadline every CHECKPOINT_INTERVAL calls, when
+    // they publish their stats to `mProgress`, and stop once either is set.
+    static const size_t CHECKPOINT_INTERVAL = 0x400;
+    mutable std::atomic<bool> mCancelled;
+    mutable std::atomic<bool> mTimedOut;
+    mutable bool mHasDeadline;
+    mutable std::chrono::steady_clock::time_point mDeadline;
+
+    struct SharedProgress
+    {
+        std::atomic<uint64_t> mCallsStarted = {0};
+        std::atomic<uint64_t> mMaxQuorumsSeen = {0};
+        std::atomic<uint64_t> mMinQuorumsSeen = {0};
+        std::atomic<uint64_t> mTerminations = {0};
+        std::atomic<uint64_t> mEarlyExits = {0};
+    };
+    mutable SharedProgress mProgress;
+
     // When run as a subroutine of criticality-checking, we inhibit
     // INFO/ERROR/WARNING level messages.
     bool mQuiet;
@@ -498,18 +546,36 @@ class QuorumIntersectionCheckerImpl : public stellar::QuorumIntersectionChecker
     mutable std::pair<std::vector<stellar::NodeID>,
                       std::vector<stellar::NodeID>>
         mPotentialSplit;
+    mutable std::mutex mPotentialSplitMutex;
 
     // These are the key state of the checker: the mapping from node public keys
     // to graph node numbers, and the graph of QBitSets itself.
     std::vector<stellar::NodeID> mBitNumPubKeys;
     std::unordered_map<stellar::NodeID, size_t> mPubKeyBitNums;
     QGraph mGraph;
+    // The quorum sets the graph was built from, by node number.
+    std::vector<stellar::SCPQuorumSetPtr> mQuorumSets;
+
+    // Result of the last complete check (or of the one of the checker this
+    // one was created from), with the nodes that decided it and their quorum
+    // sets: all the nodes if the network enjoys quorum intersection, the nodes
+    // of the split otherwise. See "Coda 3" above.
+    struct KnownResult
+    {
+        IntersectionResult mResult = INTERSECTION_UNKNOWN;
+        std::unordered_map<stellar::NodeID, stellar::SCPQuorumSetPtr>
+            mQuorumSets;
+        std::pair<std::vector<stellar::NodeID>, std::vector<stellar::NodeID>>
+            mPotentialSplit;
+    };
+    mutable KnownResult mKnown;
 
-    // This is a temporary structure that's reused very often within the
-    // MinQuorumEnumerators, but never reentrantly / simultaneously. So we
-    // allocate it once here and let the MQEs use it to avoid hammering
-    // on malloc.
-    mutable std::vector<size_t> mInDegrees;
+    // Beyond this many changed nodes in the scan SCC, a check following one
+    // that found quorum intersection scans the whole powerset again.
+    static const size_t MAX_INCREMENTAL_CHANGES = 4;
+    // Set while running an incremental check, whose enumerators can't take
+    // the first early exit as soon as a full check's.
+    mutable bool mIncremental;
 
     // This just calculates SCCs, from which we extract the first one found with
     // a quorum, which (assuming no other SCCs have quorums) we'll use for the
@@ -518,30 +584,204 @@ class QuorumIntersectionCheckerImpl : public stellar::QuorumIntersectionChecker
 
     QBitSet convertSCPQuorumSet(stellar::SCPQuorumSet const& sqs);
     void buildGraph(stellar::QuorumTracker::QuorumMap const& qmap);
+    // Copies the graph of `previous` and converts the quorum sets of `qmap`
+    // that changed since, then its SCCs if none did, unless a node joined or
+    // left. Returns true if it did.
+    bool updateGraph(QuorumIntersectionCheckerImpl const& previous,
+                     stellar::QuorumTracker::QuorumMap const& qmap);
     void buildSCCs();
 
     bool containsQuorumSlice(BitSet const& bs, QBitSet const& qbs) const;
     bool containsQuorumSliceForNode(BitSet const& bs, size_t node) const;
-    BitSet contractToMaximalQuorum(BitSet nodes) const;
+    BitSet contractToMaximalQuorum(BitSet nodes, SearchState& state) const;
 
-    const int MAX_CACHED_QUORUMS_SIZE = 0xffff;
-    mutable stellar::RandomEvictionCache<BitSet, bool, BitSet::HashFunction>
-        mCachedQuorums;
-    bool isAQuorum(BitSet const& nodes) const;
-    bool isMinimalQuorum(BitSet const& nodes) const;
+    bool isAQuorum(BitSet const& nodes, SearchState& state) const;
+    bool isMinimalQuorum(BitSet const& nodes, SearchState& state) const;
     void noteFoundDisjointQuorums(BitSet const& nodes,
                                   BitSet const& disj) const;
+
+    // Adds the stats of `state` not published yet to `mProgress`, and stops
+    // the check if it reached its deadline.
+    void checkpoint(SearchState& state) const;
+
+    // Records the result of a complete check, decided by `nodes`.
+    void noteKnownResult(IntersectionResult result, BitSet const& nodes) const;
+    // Returns true if `mKnown` has the quorum set `node` has in the graph.
+    bool isKnown(size_t node) const;
+    // Returns true if `mKnown` is a split whose nodes are in the graph with
+    // the same quorum sets.
+    bool knownSplitHolds() const;
+    bool
+    interrupted() const
+    {
+        return mCancelled.load(std::memory_order_relaxed) ||
+               mTimedOut.load(std::memory_order_relaxed);
+    }
     std::string nodeName(const stellar::NodeID node) const;
 
     friend class MinQuorumEnumerator;
+    friend class MinQuorumSearch;
 
   public:
+    // `numThreads` is the number of threads scanning the powerset of the
+    // scan SCC, 0 for one per hardware thread
     QuorumIntersectionCheckerImpl(stellar::QuorumTracker::QuorumMap const& qmap,
-                                  bool quiet = false);
+                                  bool quiet = false, size_t numThreads = 1);
+    // Checker of the network of `base` where the nodes of `group` have a
+    // "fickle" quorum set, satisfied by any single node outside of the group
+    // depending on them, and are part of every slice of those nodes. It
+    // copies the graph of `base` rather than converting all the quorum sets
+    // again, and is quiet and sequential.
+    QuorumIntersectionCheckerImpl(QuorumIntersectionCheckerImpl const& base,
+                                  std::set<stellar::NodeID> const& group);
+    // Checker of a new version of the quorum map of `previous`, see "Coda 3"
+    QuorumIntersectionCheckerImpl(
+        QuorumIntersectionCheckerImpl const& previous,
+        stellar::QuorumTracker::QuorumMap const& qmap, bool quiet,
+        size_t numThreads);
     bool networkEnjoysQuorumIntersection() const override;
 
     std::pair<std::vector<stellar::NodeID>, std::vector<stellar::NodeID>>
     getPotentialSplit() const override;
     size_t getMaxQuorumsFound() const override;
+
+    IntersectionResult
+    checkQuorumIntersection(uint64_t timeLimitMs) const override;
+    void cancel() const override;
+    Progress getProgress() const override;
+
+    friend class stellar::QuorumIntersectionChecker;
+};
+
+// A MinQuorumEnumerator is responsible to scanning the powerset of the SCC
+// we're considering, in a recursive bottom-up order, with a lot of early exits
+// described above. Each instance of MinQuorumEnumerator represents one call in
+// the recursion, and builds up to two sub-MinQuorumEnumerators for each of its
+// recursive cases.
+class MinQuorumEnumerator
+{
+
+    // Set of nodes "committed to" in this branch of the recurrence. In other
+    // words: set of nodes that this enumerator and its children will definitely
+    // include in every subset S of the powerset that they examine. This set
+    // will remain the same (omitting the split node) in one child, and expand
+    // (including the split node) in the other child.
+    BitSet mCommitted;
+
+    // Set of nodes that remain to be powerset-expanded in the recurrence. In
+    // other words: the part of the powerset that this enumerator and its
+    // children are responsible for is { committed ∪ r | r ∈ P(remaining) }.
+    // This set will strictly decrease (by the split node) in both children.
+    BitSet mRemaining;
+
+    // The set (committed ∪ remaining) which is a bound on the set of nodes in
+    // any set enumerated by this enumerator and its children.
+    BitSet mPerimeter;
+
+    // The initial value of mRemaining at the root of the search, representing
+    // the overall SCC we're considering subsets of.
+    BitSet const& mScanSCC;
+
+    // Checker that owns us, contains the graph, etc.
+    QuorumIntersectionCheckerImpl const& mQic;
+
+    // Stats and scratch space of the thread running this enumerator.
+    QuorumIntersectionCheckerImpl::SearchState& mState;
+
+    // Parallel search this enumerator is part of, or null if the search is
+    // sequential, and the worker running it.
+    MinQuorumSearch* mSearch;
+    size_t mWorker;
+
+    // Select the next node in mRemaining to split recursive cases between.
+    size_t pickSplitNode() const;
+
+    // Size limit for mCommitted beyond which we should stop scanning.
+    size_t maxCommit() const;
+
+  public:
+    MinQuorumEnumerator(BitSet const& committed, BitSet const& remaining,
+                        BitSet const& scanSCC,
+                        QuorumIntersectionCheckerImpl const& qic,
+                        QuorumIntersectionCheckerImpl::SearchState& state,
+                        MinQuorumSearch* search = nullptr, size_t worker = 0);
+
+    bool hasDisjointQuorum(BitSet const& nodes) const;
+    bool anyMinQuorumHasDisjointQuorum();
+};
+
+// A MinQuorumSearch scans the powerset of the scan SCC like the root
+// MinQuorumEnumerators of a check, but on several threads. The subproblems are kept in a
+// deque for each thread (a "worker"): when a MinQuorumEnumerator splits a
+// large enough subproblem, it pushes the branch including the split node to
+// the back of the deque of its worker and explores the other branch itself.
+// A worker takes its next subproblem from the back of its own deque or, when
+// it is empty, steals one from the front of the deque of another worker,
+// where the largest subproblems are, and waits for one to be pushed when all
+// the deques are empty. The first worker to find a min-quorum with a disjoint
+// quorum stops them all.
+class MinQuorumSearch
+{
+    struct Subproblem
+    {
+        BitSet mCommitted;
+        BitSet mRemaining;
+    };
+
+    struct Worker
+    {
+        std::mutex mMutex;
+        std::deque<Subproblem> mSubproblems;
+        QuorumIntersectionCheckerImpl::SearchState mState;
+    };
+
+    BitSet const& mScanSCC;
+    QuorumIntersectionCheckerImpl const& mQic;
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+
+    // Number of subproblems pushed and not explored yet, including the ones
+    // being explored: the search is over when it drops to 0.
+    std::atomic<size_t> mPending;
+
+    // Set when a worker found disjoint quorums or failed, to stop the others.
+    std::atomic<bool> mStopped;
+    std::atomic<bool> mFound;
+    std::mutex mErrorMutex;
+    std::exception_ptr mError;
+
+    // Number of subproblems in the deques, and of workers waiting on `mIdle`
+    // for one: `push` only notifies when a worker is waiting.
+    std::atomic<size_t> mQueued;
+    std::atomic<size_t> mWaiting;
+    std::mutex mIdleMutex;
+    std::condition_variable mIdle;
+
+    bool take(size_t worker, Subproblem& subproblem);
+    void wait();
+    void wake(bool all);
+    void stop();
+    void work(size_t worker);
+
+  public:
+    // Subproblems with fewer remaining nodes are explored by the enumerator
+    // that split them, as they are not worth the synchronization.
+    static const size_t MIN_SHARED_REMAINING = 8;
+
+    MinQuorumSearch(BitSet const& scanSCC,
+                    QuorumIntersectionCheckerImpl const& qic,
+                    size_t numThreads);
+
+    // Hands the subproblem (committed, remaining) to the workers.
+    void push(size_t worker, BitSet const& committed, BitSet const& remaining);
+
+    bool
+    stopped() const
+    {
+        return mStopped.load(std::memory_order_relaxed);
+    }
+
+    // Returns true if a min-quorum of the subproblems pushed beforehand has a
+    // disjoint quorum, like MinQuorumEnumerator::anyMinQuorumHasDisjointQuorum.
+    bool anyMinQuorumHasDisjointQuorum();
 };
 }
@@ -13,38 +13,37 @@
 #include "util/Logging.h"
 #include "util/XDROperators.h"
 #include "xdrpp/marshal.h"
+#include <algorithm>
 #include <functional>
 #include <numeric>
 #include <sstream>
 
 namespace stellar
 {
-using namespace std::placeholders;
-
-// max number of transitions that can occur from processing one message
-static const int MAX_ADVANCE_SLOT_RECURSION = 50;
-
 BallotProtocol::BallotProtocol(Slot& slot)
     : mSlot(slot)
     , mHeardFromQuorum(false)
+    , mLatestEnvelopes(slot.mNodeIndex)
+    , mTally(slot.mValuePool, slot.mArena)
     , mPhase(SCP_PHASE_PREPARE)
     , mCurrentMessageLevel(0)
+    , mStateVersion(0)
 {
 }
 
 bool
 BallotProtocol::isNewerStatement(NodeID const& nodeID, SCPStatement const& st)
 {
-    auto oldp = mLatestEnvelopes.find(nodeID);
+    auto const& oldp = mLatestEnvelopes.get(nodeID);
     bool res = false;
 
-    if (oldp == mLatestEnvelopes.end())
+    if (!oldp)
     {
         res = true;
     }
     else
     {
-        res = isNewerStatement(oldp->second->getStatement(), st);
+        res = isNewerStatement(oldp->getStatement(), st);
     }
     return res;
 }
@@ -135,27 +134,85 @@ void
 BallotProtocol::recordEnvelope(SCPEnvelopeWrapperPtr env)
 {
     auto const& st = env->getStatement();
-    auto oldp = mLatestEnvelopes.find(st.nodeID);
-    if (oldp == mLatestEnvelopes.end())
+    mTally.update(mSlot.mNodeIndex.add(st.nodeID), st);
+    mLatestEnvelopes.set(st.nodeID, env);
+    mStateVersion++;
+    mSlot.recordStatement(env->getStatement());
+}
+
+SCP::EnvelopeState
+BallotProtocol::processEnvelope(SCPEnvelopeWrapperPtr envelope, bool self)
+{
+    bool advance;
+    auto res = recordValidEnvelope(envelope, self, advance);
+    if (advance)
     {
-        mLatestEnvelopes.insert(std::make_pair(st.nodeID, env));
+        if (mAdvanceStack.empty())
+        {
+            resetIdleAttempts();
+        }
+        advanceSlot(envelope);
     }
-    else
+    return res;
+}
+
+std::vector<SCP::EnvelopeState>
+BallotProtocol::processEnvelopes(
+    std::vector<SCPEnvelopeWrapperPtr> const& envelopes)
+{
+    std::vector<SCP::EnvelopeState> res;
+    res.reserve(envelopes.size());
+    auto pres = prevalidate(envelopes);
+
+    std::vector<SCPEnvelopeWrapperPtr> hints;
+    for (size_t i = 0; i < envelopes.size(); i++)
     {
-        oldp->second = env;
+        bool advance;
+        res.emplace_back(
+            recordValidEnvelope(envelopes[i], false, advance, &pres[i]));
+        if (advance)
+        {
+            hints.emplace_back(envelopes[i]);
+        }
     }
-    mSlot.recordStatement(env->getStatement());
+
+    if (hints.empty())
+    {
+        return res;
+    }
+
+    // Each statement is used as a hint, as they may all provide candidates,
+    // but bumping, checking if we heard from a quorum and emitting our
+    // envelope are held back until the last one, like for the transitions
+    // triggered by a single message.
+    // Many nodes sending the same pledges, the steps that do nothing with
+    // a statement are skipped for the next ones until the state changes.
+    resetIdleAttempts();
+    mCurrentMessageLevel++;
+    for (size_t i = 0; i + 1 < hints.size(); i++)
+    {
+        advanceSlot(hints[i]);
+    }
+    mCurrentMessageLevel--;
+    advanceSlot(hints.back());
+
+    // the last step may have done nothing while previous ones did
+    sendLatestEnvelope();
+    return res;
 }
 
 SCP::EnvelopeState
-BallotProtocol::processEnvelope(SCPEnvelopeWrapperPtr envelope, bool self)
+BallotProtocol::recordValidEnvelope(SCPEnvelopeWrapperPtr envelope, bool self,
+                                    bool& advance, Prevalidation const* pre)
 {
+    advance = false;
     dbgAssert(envelope->getStatement().slotIndex == mSlot.getSlotIndex());
 
     SCPStatement const& statement = envelope->getStatement();
     NodeID const& nodeID = statement.nodeID;
 
-    if (!isStatementSane(statement, self))
+    // `prevalidate` already checked and logged it
+    if (pre ? pre->mInsane : !isStatementSane(statement, self))
     {
         if (self)
         {
@@ -182,7 +239,7 @@ BallotProtocol::processEnvelope(SCPEnvelopeWrapperPtr envelope, bool self)
         return SCP::EnvelopeState::INVALID;
     }
 
-    auto validationRes = validateValues(statement);
+    auto validationRes = pre ? pre->mLevel : validateValues(statement);
 
     // If the value is not valid, we just ignore it.
     if (validationRes == SCPDriver::kInvalidValue)
@@ -208,7 +265,7 @@ BallotProtocol::processEnvelope(SCPEnvelopeWrapperPtr envelope, bool self)
         }
 
         recordEnvelope(envelope);
-        advanceSlot(statement);
+        advance = true;
         return SCP::EnvelopeState::VALID;
     }
 
@@ -236,7 +293,7 @@ BallotProtocol::processEnvelope(SCPEnvelopeWrapperPtr envelope, bool self)
 bool
 BallotProtocol::isStatementSane(SCPStatement const& st, bool self)
 {
-    auto qSet = mSlot.getSCPDriver().getQSet(st.nodeID);
+    auto const& qSet = mSlot.getSCP().getQSet(st.nodeID);
     const char* errString = nullptr;
     bool res = qSet != nullptr && isQuorumSetSane(*qSet, false, errString);
     if (!res)
@@ -599,6 +656,9 @@ BallotProtocol::emitCurrentStateStatement()
         dbgAbort();
     }
 
+    // the state changed
+    mStateVersion++;
+
     SCPStatement statement = createStatement(t);
     SCPEnvelope envelope = mSlot.createEnvelope(statement);
 
@@ -607,10 +667,10 @@ BallotProtocol::emitCurrentStateStatement()
     // if we generate the same envelope, don't process it again
     // this can occur when updating h in PREPARE phase
     // as statements only keep track of h.n (but h.x could be different)
-    auto lastEnv = mLatestEnvelopes.find(mSlot.getSCP().getLocalNodeID());
+    auto const& lastEnv =
+        mLatestEnvelopes.get(mSlot.getSCP().getLocalNodeID());
 
-    if (lastEnv == mLatestEnvelopes.end() ||
-        !(lastEnv->second->getEnvelope() == envelope))
+    if (!lastEnv || !(lastEnv->getEnvelope() == envelope))
     {
         auto envW = mSlot.getSCPDriver().wrapEnvelope(envelope);
         if (mSlot.processEnvelope(envW, true) == SCP::EnvelopeState::VALID)
@@ -717,65 +777,10 @@ BallotProtocol::getPrepareCandidates(SCPStatement const& hint)
 
     std::set<SCPBallot> candidates;
 
-    while (!hintBallots.empty())
+    // find candidates that may have been prepared
+    for (auto const& topVote : hintBallots)
     {
-        auto last = --hintBallots.end();
-        SCPBallot topVote = *last;
-        hintBallots.erase(last);
-
-        auto const& val = topVote.value;
-
-        // find candidates that may have been prepared
-        for (auto const& e : mLatestEnvelopes)
-        {
-            SCPStatement const& st = e.second->getStatement();
-            switch (st.pledges.type())
-            {
-            case SCP_ST_PREPARE:
-            {
-                auto const& prep = st.pledges.prepare();
-                if (areBallotsLessAndCompatible(prep.ballot, topVote))
-                {
-                    candidates.insert(prep.ballot);
-                }
-                if (prep.prepared &&
-                    areBallotsLessAndCompatible(*prep.prepared, topVote))
-                {
-                    candidates.insert(*prep.prepared);
-                }
-                if (prep.preparedPrime &&
-                    areBallotsLessAndCompatible(*prep.preparedPrime, topVote))
-                {
-                    candidates.insert(*prep.preparedPrime);
-                }
-            }
-            break;
-            case SCP_ST_CONFIRM:
-            {
-                auto const& con = st.pledges.confirm();
-                if (areBallotsCompatible(topVote, con.ballot))
-                {
-                    candidates.insert(topVote);
-                    if (con.nPrepared < topVote.counter)
-                    {
-                        candidates.insert(SCPBallot(con.nPrepared, val));
-                    }
-                }
-            }
-            break;
-            case SCP_ST_EXTERNALIZE:
-            {
-                auto const& ext = st.pledges.externalize();
-                if (areBallotsCompatible(topVote, ext.commit))
-                {
-                    candidates.insert(topVote);
-                }
-            }
-            break;
-            default:
-                abort();
-            }
-        }
+        mTally.getPrepareCandidates(topVote, candidates);
     }
 
     return candidates;
@@ -838,39 +843,8 @@ BallotProtocol::attemptAcceptPrepared(SCPStatement const& hint)
             // otherwise, there is a chance it increases p'
         }
 
-        bool accepted = federatedAccept(
-            // checks if any node is voting for this ballot
-            [&ballot](SCPStatement const& st) {
-                bool res;
-
-                switch (st.pledges.type())
-                {
-                case SCP_ST_PREPARE:
-                {
-                    auto const& p = st.pledges.prepare();
-                    res = areBallotsLessAndCompatible(ballot, p.ballot);
-                }
-                break;
-                case SCP_ST_CONFIRM:
-                {
-                    auto const& c = st.pledges.confirm();
-                    res = areBallotsCompatible(ballot, c.ballot);
-                }
-                break;
-                case SCP_ST_EXTERNALIZE:
-                {
-                    auto const& e = st.pledges.externalize();
-                    res = areBallotsCompatible(ballot, e.commit);
-                }
-                break;
-                default:
-                    res = false;
-                    dbgAbort();
-                }
-
-                return res;
-            },
-            std::bind(&BallotProtocol::hasPreparedBallot, ballot, _1));
+        bool accepted = federatedAccept(mTally.votedPrepared(ballot),
+                                        mTally.acceptedPrepared(ballot));
         if (accepted)
         {
             return setAcceptPrepared(ballot);
@@ -948,8 +922,7 @@ BallotProtocol::attemptConfirmPrepared(SCPStatement const& hint)
             break;
         }
 
-        bool ratified = federatedRatify(
-            std::bind(&BallotProtocol::hasPreparedBallot, ballot, _1));
+        bool ratified = federatedRatify(mTally.acceptedPrepared(ballot));
         if (ratified)
         {
             newH = ballot;
@@ -986,8 +959,8 @@ BallotProtocol::attemptConfirmPrepared(SCPStatement const& hint)
                 {
                     continue;
                 }
-                bool ratified = federatedRatify(
-                    std::bind(&BallotProtocol::hasPreparedBallot, ballot, _1));
+                bool ratified =
+                    federatedRatify(mTally.acceptedPrepared(ballot));
                 if (ratified)
                 {
                     newC = ballot;
@@ -1003,40 +976,6 @@ BallotProtocol::attemptConfirmPrepared(SCPStatement const& hint)
     return res;
 }
 
-bool
-BallotProtocol::commitPredicate(SCPBallot const& ballot, Interval const& check,
-                                SCPStatement const& st)
-{
-    bool res = false;
-    auto const& pl = st.pledges;
-    switch (pl.type())
-    {
-    case SCP_ST_PREPARE:
-        break;
-    case SCP_ST_CONFIRM:
-    {
-        auto const& c = pl.confirm();
-        if (areBallotsCompatible(ballot, c.ballot))
-        {
-            res = c.nCommit <= check.first && check.second <= c.nH;
-        }
-    }
-    break;
-    case SCP_ST_EXTERNALIZE:
-    {
-        auto const& e = pl.externalize();
-        if (areBallotsCompatible(ballot, e.commit))
-        {
-            res = e.commit.counter <= check.first;
-        }
-    }
-    break;
-    default:
-        dbgAbort();
-    }
-    return res;
-}
-
 bool
 BallotProtocol::setConfirmPrepared(SCPBallot const& newC, SCPBallot const& newH)
 {
@@ -1048,7 +987,7 @@ BallotProtocol::setConfirmPrepared(SCPBallot const& newC, SCPBallot const& newH)
     bool didWork = false;
 
     // remember newH's value
-    mValueOverride = mSlot.getSCPDriver().wrapValue(newH.value);
+    mValueOverride = mSlot.mValuePool.wrap(newH.value);
 
     // we don't set c/h if we're not on a compatible ballot
     if (!mCurrentBallot ||
@@ -1085,10 +1024,11 @@ BallotProtocol::setConfirmPrepared(SCPBallot const& newC, SCPBallot const& newH)
     return didWork;
 }
 
+template <typename Pred>
 void
 BallotProtocol::findExtendedInterval(Interval& candidate,
                                      std::set<uint32> const& boundaries,
-                                     std::function<bool(Interval const&)> pred)
+                                     Pred const& pred)
 {
     // iterate through interesting boundaries, starting from the top
     for (auto it = boundaries.rbegin(); it != boundaries.rend(); it++)
@@ -1225,48 +1165,8 @@ BallotProtocol::attemptAcceptCommit(SCPStatement const& hint)
     }
 
     auto pred = [&ballot, this](Interval const& cur) -> bool {
-        return federatedAccept(
-            [&](SCPStatement const& st) -> bool {
-                bool res = false;
-                auto const& pl = st.pledges;
-                switch (pl.type())
-                {
-                case SCP_ST_PREPARE:
-                {
-                    auto const& p = pl.prepare();
-                    if (areBallotsCompatible(ballot, p.ballot))
-                    {
-                        if (p.nC != 0)
-                        {
-                            res = p.nC <= cur.first && cur.second <= p.nH;
-                        }
-                    }
-                }
-                break;
-                case SCP_ST_CONFIRM:
-                {
-                    auto const& c = pl.confirm();
-                    if (areBallotsCompatible(ballot, c.ballot))
-                    {
-                        res = c.nCommit <= cur.first;
-                    }
-                }
-                break;
-                case SCP_ST_EXTERNALIZE:
-                {
-                    auto const& e = pl.externalize();
-                    if (areBallotsCompatible(ballot, e.commit))
-                    {
-                        res = e.commit.counter <= cur.first;
-                    }
-                }
-                break;
-                default:
-                    dbgAbort();
-                }
-                return res;
-            },
-            std::bind(&BallotProtocol::commitPredicate, ballot, cur, _1));
+        return federatedAccept(mTally.votedCommit(ballot.value, cur),
+                               mTally.acceptedCommit(ballot.value, cur));
     };
 
     // build the boundaries to scan
@@ -1310,7 +1210,7 @@ BallotProtocol::setAcceptCommit(SCPBallot const& c, SCPBallot const& h)
     bool didWork = false;
 
     // remember h's value
-    mValueOverride = mSlot.getSCPDriver().wrapValue(h.value);
+    mValueOverride = mSlot.mValuePool.wrap(h.value);
 
     if (!mHighBallot || !mCommit ||
         compareBallots(mHighBallot->getBallot(), h) != 0 ||
@@ -1366,10 +1266,10 @@ statementBallotCounter(SCPStatement const& st)
 static bool
 hasVBlockingSubsetStrictlyAheadOf(
     std::shared_ptr<LocalNode> localNode,
-    std::map<NodeID, SCPEnvelopeWrapperPtr> const& map, uint32_t n)
+    EnvelopeTable const& envs, uint32_t n)
 {
     return LocalNode::isVBlocking(
-        localNode->getQuorumSet(), map,
+        *localNode, envs,
         [&](SCPStatement const& st) { return statementBallotCounter(st) > n; });
 }
 
@@ -1482,8 +1382,7 @@ BallotProtocol::attemptConfirmCommit(SCPStatement const& hint)
     Interval candidate;
 
     auto pred = [&ballot, this](Interval const& cur) -> bool {
-        return federatedRatify(
-            std::bind(&BallotProtocol::commitPredicate, ballot, cur, _1));
+        return federatedRatify(mTally.acceptedCommit(ballot.value, cur));
     };
 
     findExtendedInterval(candidate, boundaries, pred);
@@ -1523,44 +1422,6 @@ BallotProtocol::setConfirmCommit(SCPBallot const& c, SCPBallot const& h)
     return true;
 }
 
-bool
-BallotProtocol::hasPreparedBallot(SCPBallot const& ballot,
-                                  SCPStatement const& st)
-{
-    bool res;
-
-    switch (st.pledges.type())
-    {
-    case SCP_ST_PREPARE:
-    {
-        auto const& p = st.pledges.prepare();
-        res =
-            (p.prepared && areBallotsLessAndCompatible(ballot, *p.prepared)) ||
-            (p.preparedPrime &&
-             areBallotsLessAndCompatible(ballot, *p.preparedPrime));
-    }
-    break;
-    case SCP_ST_CONFIRM:
-    {
-        auto const& c = st.pledges.confirm();
-        SCPBallot prepared(c.nPrepared, c.ballot.value);
-        res = areBallotsLessAndCompatible(ballot, prepared);
-    }
-    break;
-    case SCP_ST_EXTERNALIZE:
-    {
-        auto const& e = st.pledges.externalize();
-        res = areBallotsCompatible(ballot, e.commit);
-    }
-    break;
-    default:
-        res = false;
-        dbgAbort();
-    }
-
-    return res;
-}
-
 SCPBallot
 BallotProtocol::getWorkingBallot(SCPStatement const& st)
 {
@@ -1791,10 +1652,10 @@ BallotProtocol::processCurrentState(
 SCPEnvelope const*
 BallotProtocol::getLatestMessage(NodeID const& id) const
 {
-    auto it = mLatestEnvelopes.find(id);
-    if (it != mLatestEnvelopes.end())
+    auto const& env = mLatestEnvelopes.get(id);
+    if (env)
     {
-        return &it->second->getEnvelope();
+        return &env->getEnvelope();
     }
     return nullptr;
 }
@@ -1831,60 +1692,142 @@ BallotProtocol::getExternalizingState() const
 }
 
 void
-BallotProtocol::advanceSlot(SCPStatement const& hint)
+BallotProtocol::advanceSlot(SCPEnvelopeWrapperPtr const& hint)
 {
-    mCurrentMessageLevel++;
-    if (Logging::logTrace("SCP"))
-        CLOG(TRACE, "SCP") << "BallotProtocol::advanceSlot "
-                           << mCurrentMessageLevel << " " << getLocalState();
+    mAdvanceStack.push_back({hint, ++mCurrentMessageLevel, 0, false});
 
-    if (mCurrentMessageLevel >= MAX_ADVANCE_SLOT_RECURSION)
+    // a statement emitted by a step of a running loop is processed by it
+    if (mAdvanceStack.size() > 1)
     {
-        throw std::runtime_error(
-            "maximum number of transitions reached in advanceSlot");
+        return;
     }
 
-    // attempt* methods will queue up messages, causing advanceSlot to be
-    // called recursively
-
-    // done in order so that we follow the steps from the white paper in
-    // order
-    // allowing the state to be updated properly
+    try
+    {
+        while (!mAdvanceStack.empty())
+        {
+            advanceStep();
+        }
+    }
+    catch (...)
+    {
+        mCurrentMessageLevel = mAdvanceStack.front().mLevel - 1;
+        mAdvanceStack.clear();
+        throw;
+    }
+}
 
+void
+BallotProtocol::advanceStep()
+{
+    // steps may push frames, so this one is only accessed by index
+    size_t frame = mAdvanceStack.size() - 1;
+    auto hint = mAdvanceStack[frame].mHint;
+    int level = mAdvanceStack[frame].mLevel;
+    int step = mAdvanceStack[frame].mStep++;
     bool didWork = false;
 
-    didWork = attemptAcceptPrepared(hint) || didWork;
-
-    didWork = attemptConfirmPrepared(hint) || didWork;
-
-    didWork = attemptAcceptCommit(hint) || didWork;
-
-    didWork = attemptConfirmCommit(hint) || didWork;
-
-    // only bump after we're done with everything else
-    if (mCurrentMessageLevel == 1)
-    {
-        bool didBump = false;
-        do
+    switch (step)
+    {
+    case 0:
+        if (Logging::logTrace("SCP"))
+            CLOG(TRACE, "SCP") << "BallotProtocol::advanceSlot " << level << " "
+                               << getLocalState();
+    // fall through
+    case 1:
+    case 2:
+    case 3:
+    {
+        // attempt* methods emit statements, that go through the steps
+        // before the next attempt
+
+        // done in order so that we follow the steps from the white paper in
+        // order
+        // allowing the state to be updated properly
+        auto const& st = hint->getStatement();
+        auto& idle = mIdleAttempts[step];
+        if (idle.mHint && idle.mVersion == mStateVersion &&
+            (idle.mHint == hint ||
+             idle.mHint->getStatement().pledges == st.pledges))
         {
-            // attemptBump may invoke advanceSlot recursively
-            didBump = attemptBump();
-            didWork = didBump || didWork;
-        } while (didBump);
-
-        checkHeardFromQuorum();
+            break;
+        }
+        switch (step)
+        {
+        case 0:
+            didWork = attemptAcceptPrepared(st);
+            break;
+        case 1:
+            didWork = attemptConfirmPrepared(st);
+            break;
+        case 2:
+            didWork = attemptAcceptCommit(st);
+            break;
+        default:
+            didWork = attemptConfirmCommit(st);
+            break;
+        }
+        if (didWork)
+        {
+            mStateVersion++;
+        }
+        else
+        {
+            idle.mHint = hint;
+            idle.mVersion = mStateVersion;
+        }
     }
+    break;
+    case 4:
+        // only bump after we're done with everything else
+        if (level == 1)
+        {
+            // the statements emitted by a bump are processed before trying
+            // again
+            didWork = attemptBump();
+            if (didWork)
+            {
+                mStateVersion++;
+                mAdvanceStack[frame].mStep = step;
+            }
+        }
+        break;
+    case 5:
+        if (level == 1)
+        {
+            checkHeardFromQuorum();
+        }
+        break;
+    default:
+    {
+        if (Logging::logTrace("SCP"))
+            CLOG(TRACE, "SCP") << "BallotProtocol::advanceSlot " << level
+                               << " - exiting " << getLocalState();
 
-    if (Logging::logTrace("SCP"))
-        CLOG(TRACE, "SCP") << "BallotProtocol::advanceSlot "
-                           << mCurrentMessageLevel << " - exiting "
-                           << getLocalState();
+        bool frameDidWork = mAdvanceStack[frame].mDidWork;
+        mAdvanceStack.pop_back();
+        --mCurrentMessageLevel;
 
-    --mCurrentMessageLevel;
+        if (frameDidWork)
+        {
+            sendLatestEnvelope();
+        }
+        return;
+    }
+    }
 
     if (didWork)
     {
-        sendLatestEnvelope();
+        mAdvanceStack[frame].mDidWork = true;
+    }
+}
+
+void
+BallotProtocol::resetIdleAttempts()
+{
+    for (auto& idle : mIdleAttempts)
+    {
+        idle.mHint.reset();
     }
 }
 
@@ -1938,18 +1881,57 @@ BallotProtocol::validateValues(SCPStatement const& st)
         return SCPDriver::kInvalidValue;
     }
 
-    SCPDriver::ValidationLevel res = std::accumulate(
-        values.begin(), values.end(), SCPDriver::kFullyValidatedValue,
-        [&](SCPDriver::ValidationLevel lv, stellar::Value const& v) {
-            if (lv > SCPDriver::kInvalidValue)
+    auto& pool = mSlot.mValuePool;
+    std::vector<ValuePool::ValueID> ids;
+    for (auto const& v : values)
+    {
+        ids.emplace_back(pool.intern(v));
+    }
+    std::vector<SCPDriver::ValidationLevel> levels;
+    pool.validateAll(mSlot.getSlotIndex(), ids, false, levels);
+    return *std::min_element(levels.begin(), levels.end());
+}
+
+std::vector<BallotProtocol::Prevalidation>
+BallotProtocol::prevalidate(std::vector<SCPEnvelopeWrapperPtr> const& envelopes)
+{
+    std::vector<Prevalidation> res;
+    res.reserve(envelopes.size());
+    auto& pool = mSlot.mValuePool;
+    std::vector<ValuePool::ValueID> ids;
+    // the values of envelopes[i] are ids[ends[i - 1]] to ids[ends[i] - 1]
+    std::vector<size_t> ends;
+    for (auto const& envelope : envelopes)
+    {
+        auto const& st = envelope->getStatement();
+        // the stale statements are stale when recorded too, the others are
+        // checked again then as the batch can have several from a node
+        bool newer = isNewerStatement(st.nodeID, st);
+        bool insane = newer && !isStatementSane(st, false);
+        if (newer && !insane)
+        {
+            for (auto const& v : getStatementValues(st))
             {
-                auto tr = mSlot.getSCPDriver().validateValue(
-                    mSlot.getSlotIndex(), v, false);
-                lv = std::min(tr, lv);
+                ids.emplace_back(pool.intern(v));
             }
-            return lv;
-        });
+        }
+        res.push_back({insane, SCPDriver::kInvalidValue});
+        ends.emplace_back(ids.size());
+    }
+    std::vector<SCPDriver::ValidationLevel> levels;
+    pool.validateAll(mSlot.getSlotIndex(), ids, false, levels);
 
+    size_t begin = 0;
+    for (size_t i = 0; i < ends.size(); i++)
+    {
+        // the envelopes that are not recorded have no values
+        if (begin != ends[i])
+        {
+            res[i].mLevel = *std::min_element(levels.begin() + begin,
+                                              levels.begin() + ends[i]);
+        }
+        begin = ends[i];
+    }
     return res;
 }
 
@@ -1991,14 +1973,14 @@ BallotProtocol::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys)
     // find the state of the node `id`
     SCPBallot b;
 
-    auto stateit = mLatestEnvelopes.find(id);
-    if (stateit == mLatestEnvelopes.end())
+    auto const& stateEnv = mLatestEnvelopes.get(id);
+    if (!stateEnv)
     {
         phase = "unknown";
     }
     else
     {
-        auto const& st = stateit->second->getStatement();
+        auto const& st = stateEnv->getStatement();
 
         switch (st.pledges.type())
         {
@@ -2033,8 +2015,8 @@ BallotProtocol::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys)
         return ret;
     }
     LocalNode::forAllNodes(*qSet, [&](NodeID const& n) {
-        auto it = mLatestEnvelopes.find(n);
-        if (it == mLatestEnvelopes.end())
+        auto const& env = mLatestEnvelopes.get(n);
+        if (!env)
         {
             if (!summary)
             {
@@ -2044,7 +2026,7 @@ BallotProtocol::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys)
         }
         else
         {
-            auto& st = it->second->getStatement();
+            auto& st = env->getStatement();
             if (areBallotsCompatible(getWorkingBallot(st), b))
             {
                 agree++;
@@ -2124,14 +2106,13 @@ BallotProtocol::getLocalNode()
 }
 
 bool
-BallotProtocol::federatedAccept(StatementPredicate voted,
-                                StatementPredicate accepted)
+BallotProtocol::federatedAccept(BitSet const& voted, BitSet const& accepted)
 {
     return mSlot.federatedAccept(voted, accepted, mLatestEnvelopes);
 }
 
 bool
-BallotProtocol::federatedRatify(StatementPredicate voted)
+BallotProtocol::federatedRatify(BitSet const& voted)
 {
     return mSlot.federatedRatify(voted, mLatestEnvelopes);
 }
@@ -2148,8 +2129,10 @@ BallotProtocol::checkHeardFromQuorum()
     if (mCurrentBallot)
     {
         if (LocalNode::isQuorum(
-                getLocalNode()->getQuorumSet(), mLatestEnvelopes,
-                std::bind(&Slot::getQuorumSetFromStatement, &mSlot, _1),
+                *getLocalNode(), mLatestEnvelopes,
+                [this](SCPStatement const& st) -> SCPQuorumSetPtr const& {
+                    return mSlot.getQuorumSetFromStatement(st);
+                },
                 [&](SCPStatement const& st) {
                     bool res;
                     if (st.pledges.type() == SCP_ST_PREPARE)
@@ -2193,7 +2176,7 @@ BallotProtocol::SCPBallotWrapperUPtr
 BallotProtocol::makeBallot(SCPBallot const& b) const
 {
     auto res = std::make_unique<SCPBallotWrapper>(
-        b.counter, mSlot.getSCPDriver().wrapValue(b.value));
+        b.counter, mSlot.mValuePool.wrap(b.value));
     return res;
 }
 
@@ -5,27 +5,32 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "lib/json/json-forwards.h"
+#include "scp/BallotTally.h"
+#include "scp/EnvelopeTable.h"
 #include "scp/SCP.h"
+#include <array>
 #include <functional>
 #include <memory>
 #include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace stellar
 {
 class Node;
 class Slot;
 
-// used to filter statements
-typedef std::function<bool(SCPStatement const& st)> StatementPredicate;
-
 /**
  * The Slot object is in charge of maintaining the state of the SCP protocol
  * for a given slot index.
  */
 class BallotProtocol
 {
+    // uses the ordering of statements
+    friend class EnvelopeInbox;
+    friend class TestSCP;
+
     Slot& mSlot;
 
     bool mHeardFromQuorum;
@@ -80,7 +85,8 @@ private:
     SCPBallotWrapperUPtr mPreparedPrime;                      // p'
     SCPBallotWrapperUPtr mHighBallot;                         // h
     SCPBallotWrapperUPtr mCommit;                             // c
-    std::map<NodeID, SCPEnvelopeWrapperPtr> mLatestEnvelopes; // M
+    EnvelopeTable mLatestEnvelopes;                           // M
+    BallotTally mTally; // what the statements of M pledge, by value
     SCPPhase mPhase;                                          // Phi
     ValueWrapperPtr mValueOverride;                           // z
 
@@ -91,6 +97,30 @@ private:
     SCPEnvelopeWrapperPtr
         mLastEnvelopeEmit; // last envelope emitted by this node
 
+    // The hints `advanceSlot` is going through, with the step each is at.
+    // A statement emitted by a step is pushed on top, so that it goes
+    // through all the steps before the next step of the hint below it.
+    struct AdvanceFrame
+    {
+        SCPEnvelopeWrapperPtr mHint;
+        int mLevel; // value of mCurrentMessageLevel for the hint
+        int mStep;
+        bool mDidWork;
+    };
+    std::vector<AdvanceFrame> mAdvanceStack;
+
+    // Changes whenever the local state or the latest envelopes do.
+    // For each `attempt*` step taking a hint, the last hint it did nothing
+    // with and the version it saw then: within a run, the step cannot do
+    // anything with a hint with the same pledges until the version changes.
+    uint64 mStateVersion;
+    struct IdleAttempt
+    {
+        SCPEnvelopeWrapperPtr mHint;
+        uint64 mVersion;
+    };
+    std::array<IdleAttempt, 4> mIdleAttempts;
+
   public:
     BallotProtocol(Slot& slot);
 
@@ -101,6 +131,13 @@ private:
     SCP::EnvelopeState processEnvelope(SCPEnvelopeWrapperPtr envelope,
                                        bool self);
 
+    // Process envelopes received for this slot as a batch: they are all
+    // recorded before the slot advances, and only the resulting state is
+    // emitted.
+    // Returns the state of each envelope.
+    std::vector<SCP::EnvelopeState>
+    processEnvelopes(std::vector<SCPEnvelopeWrapperPtr> const& envelopes);
+
     void ballotProtocolTimerExpired();
     // abandon's current ballot, move to a new ballot
     // at counter `n` (or, if n == 0, increment current counter)
@@ -153,11 +190,32 @@ private:
     // attempts to make progress using the latest statement as a hint
     // calls into the various attempt* methods, emits message
     // to make progress
-    void advanceSlot(SCPStatement const& hint);
+    void advanceSlot(SCPEnvelopeWrapperPtr const& hint);
+
+    // runs the next step of the hint on top of mAdvanceStack
+    void advanceStep();
+
+    // forgets the idle attempts, at the start of a run
+    void resetIdleAttempts();
 
     // returns true if all values in statement are valid
     SCPDriver::ValidationLevel validateValues(SCPStatement const& st);
 
+    // what `prevalidate` found about the statement of an envelope
+    struct Prevalidation
+    {
+        // true if the statement is not sane, which is only checked for
+        // newer statements
+        bool mInsane;
+        // validation level of the values of newer, sane statements
+        SCPDriver::ValidationLevel mLevel;
+    };
+
+    // checks the statements of the envelopes that are going to be recorded
+    // and validates their values at once
+    std::vector<Prevalidation>
+    prevalidate(std::vector<SCPEnvelopeWrapperPtr> const& envelopes);
+
     // send latest envelope if needed
     void sendLatestEnvelope();
 
@@ -208,27 +266,17 @@ private:
     using Interval = std::pair<uint32, uint32>;
 
     // helper function to find a contiguous range 'candidate' that satisfies the
-    // predicate.
+    // predicate, a callable taking an `Interval const&`.
     // updates 'candidate' (or leave it unchanged)
+    template <typename Pred>
     static void findExtendedInterval(Interval& candidate,
                                      std::set<uint32> const& boundaries,
-                                     std::function<bool(Interval const&)> pred);
+                                     Pred const& pred);
 
     // constructs the set of counters representing the
     // commit ballots compatible with the ballot
     std::set<uint32> getCommitBoundariesFromStatements(SCPBallot const& ballot);
 
-    // ** helper predicates that evaluate if a statement satisfies
-    // a certain property
-
-    // is ballot prepared by st
-    static bool hasPreparedBallot(SCPBallot const& ballot,
-                                  SCPStatement const& st);
-
-    // returns true if the statement commits the ballot in the range 'check'
-    static bool commitPredicate(SCPBallot const& ballot, Interval const& check,
-                                SCPStatement const& st);
-
     // attempts to update p to ballot (updating p' if needed)
     bool setPrepared(SCPBallot const& ballot);
 
@@ -262,6 +310,13 @@ private:
     // basic sanity check on statement
     bool isStatementSane(SCPStatement const& st, bool self);
 
+    // checks the envelope and records it if it is valid, setting `advance`
+    // if the slot should then advance with its statement. `pre` is what
+    // `prevalidate` found about the statement, if it was called.
+    SCP::EnvelopeState
+    recordValidEnvelope(SCPEnvelopeWrapperPtr envelope, bool self,
+                        bool& advance, Prevalidation const* pre = nullptr);
+
     // records the statement in the state machine
     void recordEnvelope(SCPEnvelopeWrapperPtr env);
 
@@ -294,8 +349,9 @@ private:
 
     std::shared_ptr<LocalNode> getLocalNode();
 
-    bool federatedAccept(StatementPredicate voted, StatementPredicate accepted);
-    bool federatedRatify(StatementPredicate voted);
+    // voted and accepted are the bits of the nodes of M, see `mTally`
+    bool federatedAccept(BitSet const& voted, BitSet const& accepted);
+    bool federatedRatify(BitSet const& voted);
 
     void startBallotProtocolTimer();
     void stopBallotProtocolTimer();
@@ -0,0 +1,262 @@
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "scp/BallotTally.h"
+#include "util/GlobalChecks.h"
+#include "util/XDROperators.h"
+
+#include <algorithm>
+
+namespace stellar
+{
+namespace
+{
+uint32 const ANY_COUNTER = UINT32_MAX;
+}
+
+BallotTally::BallotTally(ValuePool& pool, SlotArena& arena)
+    : mPool(pool)
+    , mArena(arena)
+    , mNodePledges(ArenaAllocator<PledgesList>(arena))
+    , mValues(ArenaAllocator<ValueTally>(arena))
+{
+}
+
+BallotTally::Pledges&
+BallotTally::addPledges(PledgesList& res, Value const& value)
+{
+    auto id = mPool.intern(value);
+    for (auto& p : res)
+    {
+        if (p.mValue == id)
+        {
+            return p;
+        }
+    }
+    res.emplace_back();
+    auto& p = res.back();
+    p.mValue = id;
+    p.mFlags = 0;
+    p.mNumCandidates = 0;
+    return p;
+}
+
+void
+BallotTally::getPledges(SCPStatement const& st, PledgesList& res)
+{
+    // A PREPARE votes for the ballots (n, b.value) with n <= b.counter and
+    // for committing c..h, and accepts the ballots below p and p'.
+    // A CONFIRM votes for any ballot with its value, accepts the ones below
+    // nPrepared and for committing nCommit..h, and votes to commit from nCommit
+    // on. An EXTERNALIZE votes for and accepts any ballot with its value, and
+    // for committing from its commit counter on.
+    // The candidates are the ballots `BallotProtocol::getPrepareCandidates`
+    // picks from the statement.
+    switch (st.pledges.type())
+    {
+    case SCP_ST_PREPARE:
+    {
+        auto const& p = st.pledges.prepare();
+        auto& ballot = addPledges(res, p.ballot.value);
+        ballot.mFlags |= Pledges::VOTE_PREPARE;
+        ballot.mVotePrepared = p.ballot.counter;
+        ballot.mCandidates[ballot.mNumCandidates++] = p.ballot.counter;
+        if (p.nC != 0)
+        {
+            ballot.mFlags |= Pledges::VOTE_COMMIT;
+            ballot.mVoteCommit = Interval(p.nC, p.nH);
+        }
+        for (auto const* prepared : {p.prepared.get(), p.preparedPrime.get()})
+        {
+            if (!prepared)
+            {
+                continue;
+            }
+            // only the prepared ballots of a statement can share a value
+            // with another of its ballots
+            auto& acc = addPledges(res, prepared->value);
+            acc.mAcceptPrepared = (acc.mFlags & Pledges::ACCEPT_PREPARE)
+                                      ? std::max(acc.mAcceptPrepared,
+                                                 prepared->counter)
+                                      : prepared->counter;
+            acc.mFlags |= Pledges::ACCEPT_PREPARE;
+            acc.mCandidates[acc.mNumCandidates++] = prepared->counter;
+        }
+    }
+    break;
+    case SCP_ST_CONFIRM:
+    {
+        auto const& c = st.pledges.confirm();
+        auto& p = addPledges(res, c.ballot.value);
+        p.mFlags = Pledges::VOTE_PREPARE | Pledges::ACCEPT_PREPARE |
+                   Pledges::VOTE_COMMIT | Pledges::ACCEPT_COMMIT |
+                   Pledges::ANY_CANDIDATE;
+        p.mVotePrepared = ANY_COUNTER;
+        p.mAcceptPrepared = c.nPrepared;
+        p.mVoteCommit = Interval(c.nCommit, ANY_COUNTER);
+        p.mAcceptCommit = Interval(c.nCommit, c.nH);
+        p.mCandidates[p.mNumCandidates++] = c.nPrepared;
+    }
+    break;
+    case SCP_ST_EXTERNALIZE:
+    {
+        auto const& e = st.pledges.externalize();
+        auto& p = addPledges(res, e.commit.value);
+        p.mFlags = Pledges::VOTE_PREPARE | Pledges::ACCEPT_PREPARE |
+                   Pledges::VOTE_COMMIT | Pledges::ACCEPT_COMMIT |
+                   Pledges::ANY_CANDIDATE;
+        p.mVotePrepared = ANY_COUNTER;
+        p.mAcceptPrepared = ANY_COUNTER;
+        p.mVoteCommit = Interval(e.commit.counter, ANY_COUNTER);
+        p.mAcceptCommit = Interval(e.commit.counter, ANY_COUNTER);
+    }
+    break;
+    default:
+        // nomination statements are not recorded by the ballot protocol
+        dbgAbort();
+    }
+}
+
+void
+BallotTally::count(Pledges const& pledges, size_t bit, bool add)
+{
+    while (pledges.mValue >= mValues.size())
+    {
+        mValues.emplace_back(mArena);
+    }
+    auto& tally = mValues[pledges.mValue];
+    add ? tally.mNodes.set(bit) : tally.mNodes.unset(bit);
+    if (pledges.mFlags & Pledges::ANY_CANDIDATE)
+    {
+        add ? ++tally.mAnyCounter : --tally.mAnyCounter;
+    }
+    for (uint32 i = 0; i < pledges.mNumCandidates; i++)
+    {
+        auto counter = pledges.mCandidates[i];
+        if (add)
+        {
+            ++tally.mCounters[counter];
+        }
+        else
+        {
+            auto c = tally.mCounters.find(counter);
+            dbgAssert(c != tally.mCounters.end());
+            if (--c->second == 0)
+            {
+                tally.mCounters.erase(c);
+            }
+        }
+    }
+}
+
+void
+BallotTally::update(size_t bit, SCPStatement const& st)
+{
+    while (bit >= mNodePledges.size())
+    {
+        mNodePledges.emplace_back(ArenaAllocator<Pledges>(mArena));
+    }
+    auto& pledges = mNodePledges[bit];
+    for (auto const& p : pledges)
+    {
+        count(p, bit, false);
+    }
+    pledges.clear();
+    getPledges(st, pledges);
+    for (auto const& p : pledges)
+    {
+        count(p, bit, true);
+    }
+}
+
+template <typename Pred>
+BitSet
+BallotTally::select(Value const& value, Pred pred) const
+{
+    ValuePool::ValueID id;
+    if (!mPool.find(value, id) || id >= mValues.size())
+    {
+        return BitSet();
+    }
+
+    auto const& tally = mValues[id];
+    BitSet res(mNodePledges.size());
+    for (size_t i = 0; tally.mNodes.nextSet(i); ++i)
+    {
+        for (auto const& p : mNodePledges[i])
+        {
+            if (p.mValue == id)
+            {
+                if (pred(p))
+                {
+                    res.set(i);
+                }
+                break;
+            }
+        }
+    }
+    return res;
+}
+
+void
+BallotTally::getPrepareCandidates(SCPBallot const& top,
+                                  std::set<SCPBallot>& candidates) const
+{
+    ValuePool::ValueID id;
+    if (!mPool.find(top.value, id) || id >= mValues.size())
+    {
+        return;
+    }
+
+    auto const& tally = mValues[id];
+    auto end = tally.mCounters.upper_bound(top.counter);
+    for (auto c = tally.mCounters.begin(); c != end; ++c)
+    {
+        candidates.emplace(c->first, top.value);
+    }
+    if (tally.mAnyCounter != 0)
+    {
+        candidates.emplace(top);
+    }
+}
+
+BitSet
+BallotTally::votedPrepared(SCPBallot const& ballot) const
+{
+    return select(ballot.value, [&](Pledges const& p) {
+        return (p.mFlags & Pledges::VOTE_PREPARE) &&
+               ballot.counter <= p.mVotePrepared;
+    });
+}
+
+BitSet
+BallotTally::acceptedPrepared(SCPBallot const& ballot) const
+{
+    return select(ballot.value, [&](Pledges const& p) {
+        return (p.mFlags & Pledges::ACCEPT_PREPARE) &&
+               ballot.counter <= p.mAcceptPrepared;
+    });
+}
+
+BitSet
+BallotTally::votedCommit(Value const& value, Interval const& range) const
+{
+    return select(value, [&](Pledges const& p) {
+        return (p.mFlags & Pledges::VOTE_COMMIT) &&
+               p.mVoteCommit.first <= range.first &&
+               range.second <= p.mVoteCommit.second;
+    });
+}
+
+BitSet
+BallotTally::acceptedCommit(Value const& value, Interval const& range) const
+{
+    return select(value, [&](Pledges const& p) {
+        return (p.mFlags & Pledges::ACCEPT_COMMIT) &&
+               p.mAcceptCommit.first <= range.first &&
+               range.second <= p.mAcceptCommit.second;
+    });
+}
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "scp/SlotArena.h"
+#include "scp/ValuePool.h"
+#include "util/BitSet.h"
+#include "xdr/Stellar-SCP.h"
+
+#include <array>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+namespace stellar
+{
+// What the latest ballot statements of the nodes of a slot say about each
+// value, by the IDs the slot's `ValuePool` gives to values and the bit numbers
+// its `NodeIndex` gives to NodeIDs.
+//
+// `BallotProtocol::recordEnvelope` keeps it up to date as statements replace
+// each other, so that the federated checks get the set of nodes that voted for
+// or accepted a ballot (or a range of commit ballots) directly, instead of
+// running a predicate over every statement for every candidate.
+// Its structures change with every statement and are allocated from the
+// slot's arena.
+class BallotTally
+{
+  public:
+    typedef std::pair<uint32, uint32> Interval;
+
+  private:
+    // What a single statement pledges for one of its values.
+    // A statement pledges for ballots (n, value) up to a counter, and
+    // for commit ballots in a range of counters, `UINT32_MAX` standing for
+    // "any counter".
+    struct Pledges
+    {
+        enum Flags : uint32
+        {
+            VOTE_PREPARE = 1,
+            ACCEPT_PREPARE = 2,
+            VOTE_COMMIT = 4,
+            ACCEPT_COMMIT = 8,
+            // the ballot with the value and any counter may have been prepared
+            ANY_CANDIDATE = 16
+        };
+
+        ValuePool::ValueID mValue;
+        uint32 mFlags;
+        // highest counter n voted / accepted as prepared
+        uint32 mVotePrepared;
+        uint32 mAcceptPrepared;
+        // range [low, high] containing the commit ranges voted / accepted
+        Interval mVoteCommit;
+        Interval mAcceptCommit;
+        // counters of the ballots with the value that may have been prepared
+        // (ballot, p and p' of a PREPARE)
+        uint32 mNumCandidates;
+        std::array<uint32, 3> mCandidates;
+    };
+
+    typedef std::vector<Pledges, ArenaAllocator<Pledges>> PledgesList;
+    typedef std::map<uint32, size_t, std::less<uint32>,
+                     ArenaAllocator<std::pair<uint32 const, size_t>>>
+        CounterMap;
+
+    struct ValueTally
+    {
+        explicit ValueTally(SlotArena& arena)
+            : mCounters(ArenaAllocator<CounterMap::value_type>(arena))
+        {
+        }
+
+        // nodes with pledges for the value
+        BitSet mNodes;
+
+        // Counters of the ballots with the value that the statements
+        // prepared or voted for, with the number of times each appears, and
+        // the number of statements that vote for the ballots with any counter.
+        // Those are the ballots that may have been prepared.
+        CounterMap mCounters;
+        size_t mAnyCounter = 0;
+    };
+
+    ValuePool& mPool;
+    SlotArena& mArena;
+
+    // pledges of the latest statement of each node, indexed by bit number
+    std::vector<PledgesList, ArenaAllocator<PledgesList>> mNodePledges;
+    // indexed by value ID
+    std::vector<ValueTally, ArenaAllocator<ValueTally>> mValues;
+
+    Pledges& addPledges(PledgesList& res, Value const& value);
+    void getPledges(SCPStatement const& st, PledgesList& res);
+    void count(Pledges const& pledges, size_t bit, bool add);
+
+    template <typename Pred>
+    BitSet select(Value const& value, Pred pred) const;
+
+  public:
+    BallotTally(ValuePool& pool, SlotArena& arena);
+
+    // replaces the pledges of the node numbered `bit` with the ones of its
+    // latest statement `st`
+    void update(size_t bit, SCPStatement const& st);
+
+    // adds to `candidates` the ballots that may have been prepared with the
+    // value of `top` and a counter up to the one of `top`
+    void getPrepareCandidates(SCPBallot const& top,
+                              std::set<SCPBallot>& candidates) const;
+
+    // nodes that voted to prepare `ballot`
+    BitSet votedPrepared(SCPBallot const& ballot) const;
+    // nodes that accepted `ballot` as prepared
+    BitSet acceptedPrepared(SCPBallot const& ballot) const;
+    // nodes that voted to commit the ballots (n, value) for n in `range`
+    BitSet votedCommit(Value const& value, Interval const& range) const;
+    // nodes that accepted to commit the ballots (n, value) for n in `range`
+    BitSet acceptedCommit(Value const& value, Interval const& range) const;
+};
+}
@@ -0,0 +1,162 @@
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "scp/CompiledQuorumSet.h"
+#include "scp/LocalNode.h"
+
+namespace stellar
+{
+size_t
+NodeIndex::add(NodeID const& nodeID)
+{
+    auto res = mBits.emplace(nodeID, mNodes.size());
+    if (res.second)
+    {
+        mNodes.emplace_back(nodeID);
+    }
+    return res.first->second;
+}
+
+bool
+NodeIndex::find(NodeID const& nodeID, size_t& bit) const
+{
+    auto it = mBits.find(nodeID);
+    if (it == mBits.end())
+    {
+        return false;
+    }
+    bit = it->second;
+    return true;
+}
+
+CompiledQuorumSet const&
+NodeIndex::compile(SCPQuorumSetPtr const& qSet)
+{
+    auto it = mCompiled.find(qSet.get());
+    if (it == mCompiled.end())
+    {
+        LocalNode::forAllNodes(*qSet, [&](NodeID const& n) {
+            add(n);
+            return true;
+        });
+        auto compiled = std::make_unique<CompiledQuorumSet>(*qSet, *this);
+        it = mCompiled
+                 .emplace(qSet.get(),
+                          std::make_pair(qSet, std::move(compiled)))
+                 .first;
+    }
+    return *it->second.second;
+}
+
+CompiledQuorumSet const&
+NodeIndex::compileLocal(SCPQuorumSet const& qSet, uint64 version)
+{
+    if (!mLocal || mLocalQSet != &qSet || mLocalVersion != version)
+    {
+        LocalNode::forAllNodes(qSet, [&](NodeID const& n) {
+            add(n);
+            return true;
+        });
+        mLocal = std::make_unique<CompiledQuorumSet>(qSet, *this);
+        mLocalQSet = &qSet;
+        mLocalVersion = version;
+    }
+    return *mLocal;
+}
+
+CompiledQuorumSet::CompiledQuorumSet(SCPQuorumSet const& qSet,
+                                     NodeIndex const& index)
+    : mThreshold(qSet.threshold)
+    , mSize(static_cast<uint32>(qSet.validators.size() +
+                                qSet.innerSets.size()))
+    , mNodes(index.size())
+{
+    for (auto const& v : qSet.validators)
+    {
+        size_t bit;
+        if (index.find(v, bit))
+        {
+            if (mNodes.get(bit))
+            {
+                mRepeated.emplace_back(bit);
+            }
+            else
+            {
+                mNodes.set(bit);
+            }
+        }
+    }
+    mAllNodes = mNodes;
+    mInnerSets.reserve(qSet.innerSets.size());
+    for (auto const& inner : qSet.innerSets)
+    {
+        mInnerSets.emplace_back(inner, index);
+        mAllNodes |= mInnerSets.back().mAllNodes;
+    }
+}
+
+size_t
+CompiledQuorumSet::countNodes(BitSet const& nodes) const
+{
+    size_t count = mNodes.intersectionCount(nodes);
+    for (auto bit : mRepeated)
+    {
+        if (nodes.get(bit))
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool
+CompiledQuorumSet::isQuorumSlice(BitSet const& nodes) const
+{
+    // like `LocalNode::isQuorumSliceInternal`, a threshold of 0 is never met
+    if (mThreshold == 0)
+    {
+        return false;
+    }
+
+    size_t count = countNodes(nodes);
+    if (count >= mThreshold)
+    {
+        return true;
+    }
+    for (auto const& inner : mInnerSets)
+    {
+        if (inner.isQuorumSlice(nodes) && ++count >= mThreshold)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+CompiledQuorumSet::isVBlocking(BitSet const& nodes) const
+{
+    // There is no v-blocking set for {\empty}
+    if (mThreshold == 0)
+    {
+        return false;
+    }
+
+    int64 leftTillBlock = int64(1) + mSize - mThreshold;
+    int64 count = static_cast<int64>(countNodes(nodes));
+    if (count > 0 && count >= leftTillBlock)
+    {
+        return true;
+    }
+    for (auto const& inner : mInnerSets)
+    {
+        if (inner.isVBlocking(nodes) && ++count >= leftTillBlock)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+}
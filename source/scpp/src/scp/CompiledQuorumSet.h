@@ -0,0 +1,112 @@
+#pragma once
+
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "util/BitSet.h"
+#include "util/UnorderedMap.h"
+#include "xdr/Stellar-SCP.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace stellar
+{
+class NodeIndex;
+typedef std::shared_ptr<SCPQuorumSet> SCPQuorumSetPtr;
+
+// A quorum set flattened against a `NodeIndex`: each level keeps its
+// threshold and the bits of its validators, so that `isQuorumSlice` and
+// `isVBlocking` are a popcount of the intersection per level instead of a
+// search of the node set per validator.
+//
+// Validators that are not in the index when the quorum set is compiled can
+// never be part of a node set built from that index, so they only count
+// toward the size of their level.
+class CompiledQuorumSet
+{
+    uint32 mThreshold;
+    // number of entries (validators and inner sets) at this level
+    uint32 mSize;
+    BitSet mNodes;
+    // bits of validators listed more than once at this level, once per extra
+    // occurrence; sane quorum sets never have any
+    std::vector<size_t> mRepeated;
+    std::vector<CompiledQuorumSet> mInnerSets;
+    // union of the validators of this level and of all inner sets
+    BitSet mAllNodes;
+
+    size_t countNodes(BitSet const& nodes) const;
+
+  public:
+    CompiledQuorumSet(SCPQuorumSet const& qSet, NodeIndex const& index);
+
+    // same semantic as `LocalNode::isQuorumSlice` / `LocalNode::isVBlocking`
+    // with `nodes` holding the bits of the node set
+    bool isQuorumSlice(BitSet const& nodes) const;
+    bool isVBlocking(BitSet const& nodes) const;
+
+    // returns true if the node numbered `bit` appears at any level
+    bool
+    dependsOn(size_t bit) const
+    {
+        return mAllNodes.get(bit);
+    }
+};
+
+// Maps the NodeIDs taking part in a computation to dense bit numbers, so that
+// sets of nodes can be represented as `BitSet`s.
+// Bit numbers are never reassigned, so node sets and compiled quorum sets
+// built from the index stay valid as nodes are added.
+class NodeIndex
+{
+    UnorderedMap<NodeID, size_t> mBits;
+    std::vector<NodeID> mNodes;
+
+    // compiled forms handed out by `compile`, along with the quorum set they
+    // were compiled from, which keeps its address from being reused
+    UnorderedMap<SCPQuorumSet const*,
+                 std::pair<SCPQuorumSetPtr, std::unique_ptr<CompiledQuorumSet>>>
+        mCompiled;
+
+    // compiled form of the quorum set of the local node handed out by
+    // `compileLocal`, with the address and version it was compiled from
+    SCPQuorumSet const* mLocalQSet = nullptr;
+    uint64 mLocalVersion = 0;
+    std::unique_ptr<CompiledQuorumSet> mLocal;
+
+  public:
+    // returns the bit number of `nodeID`, allocating a new one if needed
+    size_t add(NodeID const& nodeID);
+
+    // returns true and sets `bit` if `nodeID` has a bit number
+    bool find(NodeID const& nodeID, size_t& bit) const;
+
+    NodeID const&
+    getNode(size_t bit) const
+    {
+        return mNodes[bit];
+    }
+
+    size_t
+    size() const
+    {
+        return mNodes.size();
+    }
+
+    // returns the compiled form of `qSet`, giving bit numbers to all its
+    // validators first so that the result never needs to be recompiled.
+    // Quorum sets are not modified once shared, so the compiled form is
+    // cached by address for the lifetime of the index.
+    CompiledQuorumSet const& compile(SCPQuorumSetPtr const& qSet);
+
+    // same for the quorum set of the local node, which is modified in place
+    // rather than shared: the compiled form is kept until `version`
+    // (`LocalNode::getQuorumSetVersion`) or the address of `qSet` changes
+    CompiledQuorumSet const& compileLocal(SCPQuorumSet const& qSet,
+                                          uint64 version);
+};
+}
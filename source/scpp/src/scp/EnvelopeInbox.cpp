@@ -0,0 +1,94 @@
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "scp/EnvelopeInbox.h"
+#include "scp/BallotProtocol.h"
+#include "scp/NominationProtocol.h"
+
+#include <algorithm>
+
+namespace stellar
+{
+EnvelopeInbox::EnvelopeInbox() : mNextSeq(0)
+{
+}
+
+bool
+EnvelopeInbox::push(SCPEnvelope const& envelope)
+{
+    auto const& st = envelope.statement;
+    bool nomination = st.pledges.type() == SCPStatementType::SCP_ST_NOMINATE;
+    Key key(st.slotIndex, st.nodeID, nomination);
+
+    auto it = mPending.find(key);
+    if (it != mPending.end())
+    {
+        auto const& oldSt = it->second.mEnvelope.statement;
+        bool newer =
+            nomination
+                ? NominationProtocol::isNewerStatement(
+                      oldSt.pledges.nominate(), st.pledges.nominate())
+                : BallotProtocol::isNewerStatement(oldSt, st);
+        if (!newer)
+        {
+            return false;
+        }
+        it->second.mSeq = mNextSeq++;
+        it->second.mEnvelope = envelope;
+        return true;
+    }
+
+    mPending.emplace(key, Entry{mNextSeq++, envelope});
+    return true;
+}
+
+std::vector<SCPEnvelope>
+EnvelopeInbox::getEnvelopes() const
+{
+    std::vector<std::pair<std::pair<bool, uint64>, Entry const*>> order;
+    order.reserve(mPending.size());
+    for (auto const& p : mPending)
+    {
+        order.emplace_back(std::make_pair(std::get<2>(p.first), p.second.mSeq),
+                           &p.second);
+    }
+    std::sort(order.begin(), order.end(),
+              [](auto const& l, auto const& r) { return l.first < r.first; });
+
+    std::vector<SCPEnvelope> res;
+    res.reserve(order.size());
+    for (auto const& o : order)
+    {
+        res.emplace_back(o.second->mEnvelope);
+    }
+    return res;
+}
+
+std::vector<SCPEnvelope>
+EnvelopeInbox::drain()
+{
+    auto res = getEnvelopes();
+    mPending.clear();
+    return res;
+}
+
+size_t
+EnvelopeInbox::size() const
+{
+    return mPending.size();
+}
+
+bool
+EnvelopeInbox::empty() const
+{
+    return mPending.empty();
+}
+
+void
+EnvelopeInbox::clear()
+{
+    mPending.clear();
+}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "xdr/Stellar-SCP.h"
+
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace stellar
+{
+// Envelopes received from the network and waiting to be processed.
+//
+// Only the newest pending statement of a node for a slot and protocol
+// (nomination or ballot) is kept, using the same ordering as
+// `BallotProtocol` and `NominationProtocol`, so superseded envelopes are
+// dropped before they are validated.
+// The inbox does not check signatures, and a statement claiming to be from
+// a node keeps the older statements of that node out: the caller must
+// authenticate envelopes before pushing them.
+class EnvelopeInbox
+{
+    // slot index, node, true for nomination statements
+    typedef std::tuple<uint64, NodeID, bool> Key;
+
+    struct Entry
+    {
+        // arrival order
+        uint64 mSeq;
+        SCPEnvelope mEnvelope;
+    };
+
+    std::map<Key, Entry> mPending;
+    uint64 mNextSeq;
+
+  public:
+    EnvelopeInbox();
+
+    // queues `envelope`, replacing the pending envelope of the same node for
+    // the same slot and protocol if `envelope` is newer.
+    // Returns false if `envelope` was dropped as a pending envelope is newer
+    // or the same.
+    bool push(SCPEnvelope const& envelope);
+
+    // removes and returns the pending envelopes: ballot envelopes first,
+    // as they make the slots progress, then nomination envelopes, both in
+    // arrival order
+    std::vector<SCPEnvelope> drain();
+
+    // returns the pending envelopes in the order `drain` would
+    std::vector<SCPEnvelope> getEnvelopes() const;
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+};
+}
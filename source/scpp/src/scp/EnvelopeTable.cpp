@@ -0,0 +1,63 @@
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "scp/EnvelopeTable.h"
+
+#include <algorithm>
+
+namespace stellar
+{
+namespace
+{
+SCPEnvelopeWrapperPtr const gNoEnvelope;
+}
+
+EnvelopeTable::EnvelopeTable(NodeIndex& index) : mIndex(index)
+{
+}
+
+SCPEnvelopeWrapperPtr const&
+EnvelopeTable::get(NodeID const& nodeID) const
+{
+    size_t bit;
+    if (!mIndex.find(nodeID, bit))
+    {
+        return gNoEnvelope;
+    }
+    return getByBit(bit);
+}
+
+SCPEnvelopeWrapperPtr const&
+EnvelopeTable::getByBit(size_t bit) const
+{
+    if (bit >= mEntries.size())
+    {
+        return gNoEnvelope;
+    }
+    return mEntries[bit].second;
+}
+
+void
+EnvelopeTable::set(NodeID const& nodeID, SCPEnvelopeWrapperPtr env)
+{
+    size_t bit = mIndex.add(nodeID);
+    if (bit >= mEntries.size())
+    {
+        mEntries.resize(mIndex.size());
+    }
+
+    auto& entry = mEntries[bit];
+    if (!entry.second)
+    {
+        entry.first = nodeID;
+        auto it = std::lower_bound(
+            mOrder.begin(), mOrder.end(), nodeID,
+            [&](size_t b, NodeID const& n) { return mEntries[b].first < n; });
+        mOrder.insert(it, bit);
+        mNodes.set(bit);
+    }
+    entry.second = std::move(env);
+}
+}
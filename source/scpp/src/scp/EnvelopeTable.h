@@ -0,0 +1,142 @@
+#pragma once
+
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "scp/CompiledQuorumSet.h"
+#include "scp/SCPDriver.h"
+
+#include <utility>
+#include <vector>
+
+namespace stellar
+{
+// The latest envelope of each node for one protocol of a slot.
+//
+// Entries are stored in a contiguous array by the bit numbers the slot's
+// `NodeIndex` gives to NodeIDs, along with a `BitSet` of the nodes that have
+// an envelope, so that statement filters produce node sets that compiled
+// quorum sets can evaluate directly.
+// Iteration is in NodeID order, like the `std::map` this replaces.
+class EnvelopeTable
+{
+  public:
+    typedef std::pair<NodeID, SCPEnvelopeWrapperPtr> Entry;
+
+  private:
+    NodeIndex& mIndex;
+    // indexed by bit number, entries of nodes without an envelope are null
+    std::vector<Entry> mEntries;
+    // bit numbers of the nodes that have an envelope, sorted by NodeID
+    std::vector<size_t> mOrder;
+    BitSet mNodes;
+
+  public:
+    class const_iterator
+    {
+        EnvelopeTable const* mTable;
+        std::vector<size_t>::const_iterator mIt;
+
+      public:
+        const_iterator(EnvelopeTable const* table,
+                       std::vector<size_t>::const_iterator it)
+            : mTable(table), mIt(it)
+        {
+        }
+
+        Entry const& operator*() const
+        {
+            return mTable->mEntries[*mIt];
+        }
+        Entry const* operator->() const
+        {
+            return &mTable->mEntries[*mIt];
+        }
+        const_iterator&
+        operator++()
+        {
+            ++mIt;
+            return *this;
+        }
+        bool
+        operator==(const_iterator const& other) const
+        {
+            return mIt == other.mIt;
+        }
+        bool
+        operator!=(const_iterator const& other) const
+        {
+            return mIt != other.mIt;
+        }
+    };
+
+    explicit EnvelopeTable(NodeIndex& index);
+
+    // returns the latest envelope of `nodeID`, null if there is none
+    SCPEnvelopeWrapperPtr const& get(NodeID const& nodeID) const;
+
+    // returns the latest envelope of the node numbered `bit` by the index,
+    // null if there is none
+    SCPEnvelopeWrapperPtr const& getByBit(size_t bit) const;
+
+    // records `env` as the latest envelope of `nodeID`
+    void set(NodeID const& nodeID, SCPEnvelopeWrapperPtr env);
+
+    // returns the bits of the nodes whose latest statement passes `filter`,
+    // a callable taking a `SCPStatement const&`
+    template <typename Filter>
+    BitSet
+    filter(Filter const& filter) const
+    {
+        BitSet res(mEntries.size());
+        for (size_t i = 0; mNodes.nextSet(i); ++i)
+        {
+            if (filter(mEntries[i].second->getStatement()))
+            {
+                res.set(i);
+            }
+        }
+        return res;
+    }
+
+    // bits of all the nodes that have an envelope
+    BitSet const&
+    getNodes() const
+    {
+        return mNodes;
+    }
+
+    // the index is shared by the slot, not owned by the table
+    NodeIndex&
+    getIndex() const
+    {
+        return mIndex;
+    }
+
+    size_t
+    size() const
+    {
+        return mOrder.size();
+    }
+
+    bool
+    empty() const
+    {
+        return mOrder.empty();
+    }
+
+    const_iterator
+    begin() const
+    {
+        return const_iterator(this, mOrder.begin());
+    }
+
+    const_iterator
+    end() const
+    {
+        return const_iterator(this, mOrder.end());
+    }
+};
+}
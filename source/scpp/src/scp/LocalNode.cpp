@@ -6,6 +6,7 @@
 
 #include "crypto/Hex.h"
 #include "lib/json/json.h"
+#include "scp/CompiledQuorumSet.h"
 #include "scp/QuorumSetUtils.h"
 #include "util/Logging.h"
 #include "util/XDROperators.h"
@@ -18,10 +19,15 @@ namespace stellar
 {
 LocalNode::LocalNode(NodeID const& nodeID, bool isValidator,
                      SCPQuorumSet const& qSet, SCPDriver& driver)
-    : mNodeID(nodeID), mIsValidator(isValidator), mQSet(qSet), mDriver(driver)
+    : mNodeID(nodeID)
+    , mIsValidator(isValidator)
+    , mQSet(qSet)
+    , mDriver(driver)
+    , mQSetVersion(0)
 {
     normalizeQSet(mQSet);
     mQSetHash = driver.getHashOf({xdr::xdr_to_opaque(mQSet)});
+    updateNodeWeights();
 
     CLOG(INFO, "SCP") << "LocalNode::LocalNode"
                       << "@" << driver.toShortString(mNodeID)
@@ -46,6 +52,34 @@ LocalNode::updateQuorumSet(SCPQuorumSet const& qSet)
     mQSetHash = mDriver.getHashOf({xdr::xdr_to_opaque(qSet)});
     CLOG(INFO, "SCP") << "LocalNode::updateQuorumSet " << hexAbbrev(mQSetHash);
     mQSet = qSet;
+    updateNodeWeights();
+}
+
+void
+LocalNode::updateNodeWeights()
+{
+    SCPQuorumSet qSet = mQSet;
+    normalizeQSet(qSet, &mNodeID); // excludes self
+
+    mNodeWeights.clear();
+    // note that node IDs here are unique ("sane")
+    forAllNodes(qSet, [&](NodeID const& cur) {
+        mNodeWeights.emplace_back(cur, getNodeWeight(cur, qSet));
+        return true;
+    });
+    mQSetVersion++;
+}
+
+std::vector<std::pair<NodeID, uint64>> const&
+LocalNode::getNodeWeights() const
+{
+    return mNodeWeights;
+}
+
+uint64
+LocalNode::getQuorumSetVersion() const
+{
+    return mQSetVersion;
 }
 
 SCPQuorumSet const&
@@ -127,36 +161,28 @@ LocalNode::getNodeWeight(NodeID const& nodeID, SCPQuorumSet const& qset)
     return 0;
 }
 
-bool
-LocalNode::isQuorumSliceInternal(SCPQuorumSet const& qset,
-                                 std::vector<NodeID> const& nodeSet)
+namespace
 {
-    uint32 thresholdLeft = qset.threshold;
-    for (auto const& validator : qset.validators)
+// gives the nodes of `nodeSet` dense bit numbers and sets them in `nodes`
+void
+indexNodes(std::vector<NodeID> const& nodeSet, NodeIndex& index, BitSet& nodes)
+{
+    for (auto const& n : nodeSet)
     {
-        auto it = std::find(nodeSet.begin(), nodeSet.end(), validator);
-        if (it != nodeSet.end())
-        {
-            thresholdLeft--;
-            if (thresholdLeft <= 0)
-            {
-                return true;
-            }
-        }
+        nodes.set(index.add(n));
     }
+}
+}
 
-    for (auto const& inner : qset.innerSets)
-    {
-        if (isQuorumSliceInternal(inner, nodeSet))
-        {
-            thresholdLeft--;
-            if (thresholdLeft <= 0)
-            {
-                return true;
-            }
-        }
-    }
-    return false;
+// evaluates the compiled form of the quorum set against the node set
+bool
+LocalNode::isQuorumSliceInternal(SCPQuorumSet const& qset,
+                                 std::vector<NodeID> const& nodeSet)
+{
+    NodeIndex index;
+    BitSet nodes;
+    indexNodes(nodeSet, index, nodes);
+    return CompiledQuorumSet(qset, index).isQuorumSlice(nodes);
 }
 
 bool
@@ -166,46 +192,15 @@ LocalNode::isQuorumSlice(SCPQuorumSet const& qSet,
     return isQuorumSliceInternal(qSet, nodeSet);
 }
 
-// called recursively
+// evaluates the compiled form of the quorum set against the node set
 bool
 LocalNode::isVBlockingInternal(SCPQuorumSet const& qset,
                                std::vector<NodeID> const& nodeSet)
 {
-    // There is no v-blocking set for {\empty}
-    if (qset.threshold == 0)
-    {
-        return false;
-    }
-
-    int leftTillBlock =
-        (int)((1 + qset.validators.size() + qset.innerSets.size()) -
-              qset.threshold);
-
-    for (auto const& validator : qset.validators)
-    {
-        auto it = std::find(nodeSet.begin(), nodeSet.end(), validator);
-        if (it != nodeSet.end())
-        {
-            leftTillBlock--;
-            if (leftTillBlock <= 0)
-            {
-                return true;
-            }
-        }
-    }
-    for (auto const& inner : qset.innerSets)
-    {
-        if (isVBlockingInternal(inner, nodeSet))
-        {
-            leftTillBlock--;
-            if (leftTillBlock <= 0)
-            {
-                return true;
-            }
-        }
-    }
-
-    return false;
+    NodeIndex index;
+    BitSet nodes;
+    indexNodes(nodeSet, index, nodes);
+    return CompiledQuorumSet(qset, index).isVBlocking(nodes);
 }
 
 bool
@@ -216,79 +211,49 @@ LocalNode::isVBlocking(SCPQuorumSet const& qSet,
 }
 
 bool
-LocalNode::isVBlocking(SCPQuorumSet const& qSet,
-                       std::map<NodeID, SCPEnvelopeWrapperPtr> const& map,
-                       std::function<bool(SCPStatement const&)> const& filter)
+LocalNode::isVBlocking(LocalNode const& localNode, EnvelopeTable const& envs,
+                       BitSet const& nodes)
 {
-    std::vector<NodeID> pNodes;
-    for (auto const& it : map)
-    {
-        if (filter(it.second->getStatement()))
-        {
-            pNodes.push_back(it.first);
-        }
-    }
-
-    return isVBlocking(qSet, pNodes);
+    return envs.getIndex()
+        .compileLocal(localNode.mQSet, localNode.mQSetVersion)
+        .isVBlocking(nodes);
 }
 
 bool
-LocalNode::isQuorum(
-    SCPQuorumSet const& qSet,
-    std::map<NodeID, SCPEnvelopeWrapperPtr> const& map,
-    std::function<SCPQuorumSetPtr(SCPStatement const&)> const& qfun,
-    std::function<bool(SCPStatement const&)> const& filter)
+LocalNode::isQuorumInternal(LocalNode const& localNode, NodeIndex& index,
+                            std::vector<CompiledQuorumSet const*> const& qSets,
+                            BitSet pNodes)
 {
-    std::vector<NodeID> pNodes;
-    for (auto const& it : map)
+    std::vector<size_t> worklist;
+    for (size_t i = 0; pNodes.nextSet(i); ++i)
     {
-        if (filter(it.second->getStatement()))
-        {
-            pNodes.push_back(it.first);
-        }
+        worklist.emplace_back(i);
     }
 
-    size_t count = 0;
-    do
+    // Remove candidates whose slice is not satisfied by the remaining
+    // candidates until the set is stable. Removing a node can only break the
+    // slices of the candidates that depend on it, so only those are
+    // examined again.
+    while (!worklist.empty())
     {
-        count = pNodes.size();
-        std::vector<NodeID> fNodes(pNodes.size());
-        auto quorumFilter = [&](NodeID nodeID) -> bool {
-            auto qSetPtr = qfun(map.find(nodeID)->second->getStatement());
-            if (qSetPtr)
-            {
-                return isQuorumSlice(*qSetPtr, pNodes);
-            }
-            else
+        size_t n = worklist.back();
+        worklist.pop_back();
+        if (!pNodes.get(n) || (qSets[n] && qSets[n]->isQuorumSlice(pNodes)))
+        {
+            continue;
+        }
+        pNodes.unset(n);
+        for (size_t d = 0; pNodes.nextSet(d); ++d)
+        {
+            if (qSets[d] && qSets[d]->dependsOn(n))
             {
-                return false;
+                worklist.emplace_back(d);
             }
-        };
-        auto it = std::copy_if(pNodes.begin(), pNodes.end(), fNodes.begin(),
-                               quorumFilter);
-        fNodes.resize(std::distance(fNodes.begin(), it));
-        pNodes = fNodes;
-    } while (count != pNodes.size());
-
-    return isQuorumSlice(qSet, pNodes);
-}
-
-std::vector<NodeID>
-LocalNode::findClosestVBlocking(
-    SCPQuorumSet const& qset,
-    std::map<NodeID, SCPEnvelopeWrapperPtr> const& map,
-    std::function<bool(SCPStatement const&)> const& filter,
-    NodeID const* excluded)
-{
-    std::set<NodeID> s;
-    for (auto const& n : map)
-    {
-        if (filter(n.second->getStatement()))
-        {
-            s.emplace(n.first);
         }
     }
-    return findClosestVBlocking(qset, s, excluded);
+
+    return index.compileLocal(localNode.mQSet, localNode.mQSetVersion)
+        .isQuorumSlice(pNodes);
 }
 
 std::vector<NodeID>
@@ -416,6 +381,7 @@ void
 LocalNode::changeNodeID(NodeID const& nodeID)
 {
     mNodeID = nodeID;
+    updateNodeWeights();
 }
 
 bool
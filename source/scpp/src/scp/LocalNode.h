@@ -6,9 +6,11 @@
 
 #include <memory>
 #include <set>
+#include <utility>
 #include <vector>
 
 #include "lib/json/json-forwards.h"
+#include "scp/EnvelopeTable.h"
 #include "scp/SCPDriver.h"
 #include "util/HashOfHash.h"
 
@@ -31,6 +33,14 @@ class LocalNode
 
     SCPDriver& mDriver;
 
+    // the other nodes of the quorum set with their weight, in the order
+    // `forAllNodes` visits them, for the nomination protocol
+    std::vector<std::pair<NodeID, uint64>> mNodeWeights;
+    // changes whenever the quorum set or the node ID does
+    uint64 mQSetVersion;
+
+    void updateNodeWeights();
+
   public:
     LocalNode(NodeID const& nodeID, bool isValidator, SCPQuorumSet const& qSet,
               SCPDriver& driver);
@@ -45,6 +55,12 @@ class LocalNode
     Hash const& getQuorumSetHash();
     bool isValidator();
 
+    // returns the nodes of the normalized quorum set other than this one,
+    // with their weight, computed when the quorum set changes
+    std::vector<std::pair<NodeID, uint64>> const& getNodeWeights() const;
+    // a number that changes whenever the result of `getNodeWeights` does
+    uint64 getQuorumSetVersion() const;
+
     // returns the quorum set {{X}}
     static SCPQuorumSetPtr getSingletonQSet(NodeID const& nodeID);
 
@@ -57,32 +73,64 @@ class LocalNode
     static uint64 getNodeWeight(NodeID const& nodeID, SCPQuorumSet const& qset);
 
     // Tests this node against nodeSet for the specified qSethash.
+    // These index `nodeSet` and compile `qSet` on every call: the consensus
+    // protocols use the overloads taking an `EnvelopeTable` instead.
     static bool isQuorumSlice(SCPQuorumSet const& qSet,
                               std::vector<NodeID> const& nodeSet);
     static bool isVBlocking(SCPQuorumSet const& qSet,
                             std::vector<NodeID> const& nodeSet);
 
-    // Tests this node against a map of nodeID -> T for the specified qSetHash.
+    // Tests `localNode` against the latest envelopes of nodes. Its quorum set
+    // is compiled once per version against the index of `envs`.
+    // The filters are callables taking a `SCPStatement const&`, templates so
+    // that they are inlined in the loop over the envelopes.
 
     // `isVBlocking` tests if the filtered nodes V are a v-blocking set for
     // this node.
-    static bool isVBlocking(
-        SCPQuorumSet const& qSet,
-        std::map<NodeID, SCPEnvelopeWrapperPtr> const& map,
-        std::function<bool(SCPStatement const&)> const& filter =
-            [](SCPStatement const&) { return true; });
+    template <typename Filter>
+    static bool
+    isVBlocking(LocalNode const& localNode, EnvelopeTable const& envs,
+                Filter const& filter)
+    {
+        return isVBlocking(localNode, envs, envs.filter(filter));
+    }
+    // same, with the nodes V given by their bits in the index of `envs`
+    static bool isVBlocking(LocalNode const& localNode,
+                            EnvelopeTable const& envs, BitSet const& nodes);
 
     // `isQuorum` tests if the filtered nodes V form a quorum
     // (meaning for each v \in V there is q \in Q(v)
     // included in V and we have quorum on V for qSetHash). `qfun` extracts the
-    // SCPQuorumSetPtr from the SCPStatement for its associated node in map
+    // SCPQuorumSetPtr from the SCPStatement for its associated node in envs
     // (required for transitivity)
-    static bool isQuorum(
-        SCPQuorumSet const& qSet,
-        std::map<NodeID, SCPEnvelopeWrapperPtr> const& map,
-        std::function<SCPQuorumSetPtr(SCPStatement const&)> const& qfun,
-        std::function<bool(SCPStatement const&)> const& filter =
-            [](SCPStatement const&) { return true; });
+    template <typename QFun, typename Filter>
+    static bool
+    isQuorum(LocalNode const& localNode, EnvelopeTable const& envs,
+             QFun const& qfun, Filter const& filter)
+    {
+        return isQuorum(localNode, envs, qfun, envs.filter(filter));
+    }
+    // same, with the nodes V given by their bits in the index of `envs`;
+    // all of them must have an envelope in `envs`
+    template <typename QFun>
+    static bool
+    isQuorum(LocalNode const& localNode, EnvelopeTable const& envs,
+             QFun const& qfun, BitSet nodes)
+    {
+        // Resolve the quorum set of every candidate once. Compiled forms are
+        // cached by the slot's index.
+        auto& index = envs.getIndex();
+        std::vector<CompiledQuorumSet const*> qSets(index.size(), nullptr);
+        for (size_t i = 0; nodes.nextSet(i); ++i)
+        {
+            auto const& qSetPtr = qfun(envs.getByBit(i)->getStatement());
+            if (qSetPtr)
+            {
+                qSets[i] = &index.compile(qSetPtr);
+            }
+        }
+        return isQuorumInternal(localNode, index, qSets, std::move(nodes));
+    }
 
     // computes the distance to the set of v-blocking sets given
     // a set of nodes that agree (but can fail)
@@ -91,12 +139,21 @@ class LocalNode
     findClosestVBlocking(SCPQuorumSet const& qset,
                          std::set<NodeID> const& nodes, NodeID const* excluded);
 
-    static std::vector<NodeID> findClosestVBlocking(
-        SCPQuorumSet const& qset,
-        std::map<NodeID, SCPEnvelopeWrapperPtr> const& map,
-        std::function<bool(SCPStatement const&)> const& filter =
-            [](SCPStatement const&) { return true; },
-        NodeID const* excluded = nullptr);
+    template <typename Filter>
+    static std::vector<NodeID>
+    findClosestVBlocking(SCPQuorumSet const& qset, EnvelopeTable const& envs,
+                         Filter const& filter, NodeID const* excluded = nullptr)
+    {
+        std::set<NodeID> s;
+        for (auto const& n : envs)
+        {
+            if (filter(n.second->getStatement()))
+            {
+                s.emplace(n.first);
+            }
+        }
+        return findClosestVBlocking(qset, s, excluded);
+    }
 
     static Json::Value toJson(SCPQuorumSet const& qSet,
                               std::function<std::string(NodeID const&)> r);
@@ -110,10 +167,17 @@ class LocalNode
     // returns a quorum set {{ nodeID }}
     static SCPQuorumSet buildSingletonQSet(NodeID const& nodeID);
 
-    // called recursively
+    // compile the quorum set against the node set and evaluate it
     static bool isQuorumSliceInternal(SCPQuorumSet const& qset,
                                       std::vector<NodeID> const& nodeSet);
     static bool isVBlockingInternal(SCPQuorumSet const& qset,
                                     std::vector<NodeID> const& nodeSet);
+
+    // `isQuorum` once the compiled quorum sets of the candidates, indexed by
+    // bit number, are known
+    static bool
+    isQuorumInternal(LocalNode const& localNode, NodeIndex& index,
+                     std::vector<CompiledQuorumSet const*> const& qSets,
+                     BitSet nodes);
 };
 }
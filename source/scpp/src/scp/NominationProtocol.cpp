@@ -18,10 +18,14 @@
 
 namespace stellar
 {
-using namespace std::placeholders;
+int32 const NominationProtocol::MAX_ROUNDS_AHEAD = 4;
 
 NominationProtocol::NominationProtocol(Slot& slot)
-    : mSlot(slot), mRoundNumber(0), mNominationStarted(false)
+    : mSlot(slot)
+    , mRoundNumber(0)
+    , mLatestNominations(slot.mNodeIndex)
+    , mNominationStarted(false)
+    , mLeadersQSetVersion(0)
 {
 }
 
@@ -29,17 +33,16 @@ bool
 NominationProtocol::isNewerStatement(NodeID const& nodeID,
                                      SCPNomination const& st)
 {
-    auto oldp = mLatestNominations.find(nodeID);
+    auto const& oldp = mLatestNominations.get(nodeID);
     bool res = false;
 
-    if (oldp == mLatestNominations.end())
+    if (!oldp)
     {
         res = true;
     }
     else
     {
-        res = isNewerStatement(oldp->second->getStatement().pledges.nominate(),
-                               st);
+        res = isNewerStatement(oldp->getStatement().pledges.nominate(), st);
     }
     return res;
 }
@@ -72,7 +75,15 @@ NominationProtocol::isSubsetHelper(xdr::xvector<Value> const& p,
 SCPDriver::ValidationLevel
 NominationProtocol::validateValue(Value const& v)
 {
-    return mSlot.getSCPDriver().validateValue(mSlot.getSlotIndex(), v, true);
+    return mSlot.mValuePool.validate(mSlot.getSlotIndex(), v, true);
+}
+
+void
+NominationProtocol::validateValues(
+    std::vector<ValuePool::ValueID> const& ids,
+    std::vector<SCPDriver::ValidationLevel>& levels)
+{
+    mSlot.mValuePool.validateAll(mSlot.getSlotIndex(), ids, true, levels);
 }
 
 ValueWrapperPtr
@@ -128,15 +139,7 @@ void
 NominationProtocol::recordEnvelope(SCPEnvelopeWrapperPtr env)
 {
     auto const& st = env->getStatement();
-    auto oldp = mLatestNominations.find(st.nodeID);
-    if (oldp == mLatestNominations.end())
-    {
-        mLatestNominations.insert(std::make_pair(st.nodeID, env));
-    }
-    else
-    {
-        oldp->second = env;
-    }
+    mLatestNominations.set(st.nodeID, env);
     mSlot.recordStatement(env->getStatement());
 }
 
@@ -213,40 +216,13 @@ NominationProtocol::applyAll(SCPNomination const& nom,
 void
 NominationProtocol::updateRoundLeaders()
 {
-    SCPQuorumSet myQSet = mSlot.getLocalNode()->getQuorumSet();
-
-    auto localID = mSlot.getLocalNode()->getNodeID();
-    normalizeQSet(myQSet, &localID); // excludes self
-
-    size_t maxLeaderCount = 1; // includes self
-    // note that node IDs here are unique ("sane"), so we can count by
-    // enumeration
-    LocalNode::forAllNodes(myQSet, [&](NodeID const& cur) {
-        ++maxLeaderCount;
-        return true;
-    });
+    // includes self
+    size_t maxLeaderCount = mSlot.getLocalNode()->getNodeWeights().size() + 1;
 
     while (mRoundLeaders.size() < maxLeaderCount)
     {
-        // initialize priority with value derived from self
-        std::set<NodeID> newRoundLeaders;
-
-        newRoundLeaders.insert(localID);
-        uint64 topPriority = getNodePriority(localID, myQSet);
+        auto const& newRoundLeaders = getRoundLeaders(mRoundNumber);
 
-        LocalNode::forAllNodes(myQSet, [&](NodeID const& cur) {
-            uint64 w = getNodePriority(cur, myQSet);
-            if (w > topPriority)
-            {
-                topPriority = w;
-                newRoundLeaders.clear();
-            }
-            if (w == topPriority && w > 0)
-            {
-                newRoundLeaders.insert(cur);
-            }
-            return true;
-        });
         // expand mRoundLeaders with the newly computed leaders
         auto oldSize = mRoundLeaders.size();
         mRoundLeaders.insert(newRoundLeaders.begin(), newRoundLeaders.end());
@@ -274,44 +250,117 @@ NominationProtocol::updateRoundLeaders()
     CLOG(DEBUG, "SCP") << "updateRoundLeaders: nothing to do";
 }
 
-uint64
-NominationProtocol::hashNode(bool isPriority, NodeID const& nodeID)
+std::set<NodeID> const&
+NominationProtocol::getRoundLeaders(int32 round)
+{
+    auto const& localNode = mSlot.getLocalNode();
+    if (mLeadersQSetVersion != localNode->getQuorumSetVersion())
+    {
+        mUpcomingLeaders.clear();
+        mLeadersQSetVersion = localNode->getQuorumSetVersion();
+    }
+    mUpcomingLeaders.erase(
+        std::remove_if(mUpcomingLeaders.begin(), mUpcomingLeaders.end(),
+                       [&](RoundLeaders const& rl) {
+                           return rl.mRound < mRoundNumber;
+                       }),
+        mUpcomingLeaders.end());
+    for (auto const& rl : mUpcomingLeaders)
+    {
+        if (rl.mRound == round)
+        {
+            return rl.mLeaders;
+        }
+    }
+
+    mUpcomingLeaders.emplace_back();
+    auto& res = mUpcomingLeaders.back();
+    res.mRound = round;
+
+    // initialize priority with value derived from self,
+    // the local node being in all quorum sets
+    auto const& localID = localNode->getNodeID();
+    res.mLeaders.insert(localID);
+    uint64 topPriority = getNodePriority(round, localID, UINT64_MAX);
+
+    for (auto const& node : localNode->getNodeWeights())
+    {
+        uint64 w = getNodePriority(round, node.first, node.second);
+        if (w > topPriority)
+        {
+            topPriority = w;
+            res.mLeaders.clear();
+        }
+        if (w == topPriority && w > 0)
+        {
+            res.mLeaders.insert(node.first);
+        }
+    }
+    return res.mLeaders;
+}
+
+void
+NominationProtocol::precomputeRoundLeaders()
+{
+    size_t maxLeaderCount = mSlot.getLocalNode()->getNodeWeights().size() + 1;
+    if (mRoundLeaders.size() >= maxLeaderCount)
+    {
+        return;
+    }
+    // the update on timeout stops at the first round bringing a new leader
+    for (int32 round = mRoundNumber + 1;
+         round <= mRoundNumber + MAX_ROUNDS_AHEAD; round++)
+    {
+        auto const& leaders = getRoundLeaders(round);
+        if (std::any_of(leaders.begin(), leaders.end(),
+                        [&](NodeID const& n) {
+                            return mRoundLeaders.find(n) ==
+                                   mRoundLeaders.end();
+                        }))
+        {
+            break;
+        }
+    }
+}
+
+HashState const&
+NominationProtocol::getHashPrefix()
 {
     dbgAssert(!mPreviousValue.empty());
-    return mSlot.getSCPDriver().computeHashNode(
-        mSlot.getSlotIndex(), mPreviousValue, isPriority, mRoundNumber, nodeID);
+    if (!mHashPrefix)
+    {
+        mHashPrefix = std::make_unique<HashState>();
+        mSlot.getSCPDriver().startNominationHash(
+            *mHashPrefix, mSlot.getSlotIndex(), mPreviousValue);
+    }
+    return *mHashPrefix;
+}
+
+uint64
+NominationProtocol::hashNode(int32 round, bool isPriority, NodeID const& nodeID)
+{
+    return mSlot.getSCPDriver().computeHashNode(getHashPrefix(), isPriority,
+                                                round, nodeID);
 }
 
 uint64
 NominationProtocol::hashValue(Value const& value)
 {
-    dbgAssert(!mPreviousValue.empty());
-    return mSlot.getSCPDriver().computeValueHash(
-        mSlot.getSlotIndex(), mPreviousValue, mRoundNumber, value);
+    return mSlot.getSCPDriver().computeValueHash(getHashPrefix(),
+                                                 mRoundNumber, value);
 }
 
 uint64
-NominationProtocol::getNodePriority(NodeID const& nodeID,
-                                    SCPQuorumSet const& qset)
+NominationProtocol::getNodePriority(int32 round, NodeID const& nodeID,
+                                    uint64 w)
 {
     uint64 res;
-    uint64 w;
-
-    if (nodeID == mSlot.getLocalNode()->getNodeID())
-    {
-        // local node is in all quorum sets
-        w = UINT64_MAX;
-    }
-    else
-    {
-        w = LocalNode::getNodeWeight(nodeID, qset);
-    }
 
     // if w > 0; w is inclusive here as
     // 0 <= hashNode <= UINT64_MAX
-    if (w > 0 && hashNode(false, nodeID) <= w)
+    if (w > 0 && hashNode(round, false, nodeID) <= w)
     {
-        res = hashNode(true, nodeID);
+        res = hashNode(round, true, nodeID);
     }
     else
     {
@@ -328,20 +377,27 @@ NominationProtocol::getNewValueFromNomination(SCPNomination const& nom)
     ValueWrapperPtr newVote;
     uint64 newHash = 0;
 
-    applyAll(nom, [&](Value const& value) {
+    auto& pool = mSlot.mValuePool;
+    std::vector<ValuePool::ValueID> ids;
+    applyAll(nom,
+             [&](Value const& value) { ids.emplace_back(pool.intern(value)); });
+    std::vector<SCPDriver::ValidationLevel> levels;
+    validateValues(ids, levels);
+
+    for (size_t i = 0; i < ids.size(); i++)
+    {
         ValueWrapperPtr valueToNominate;
-        auto vl = validateValue(value);
-        if (vl == SCPDriver::kFullyValidatedValue)
+        if (levels[i] == SCPDriver::kFullyValidatedValue)
         {
-            valueToNominate = mSlot.getSCPDriver().wrapValue(value);
+            valueToNominate = pool.getWrapper(ids[i]);
         }
         else
         {
-            valueToNominate = extractValidValue(value);
+            valueToNominate = extractValidValue(pool.getValue(ids[i]));
         }
         if (valueToNominate)
         {
-            if (mVotes.find(valueToNominate) == mVotes.end())
+            if (!mVotes.contains(valueToNominate))
             {
                 uint64 curHash = hashValue(valueToNominate->getValue());
                 if (curHash >= newHash)
@@ -351,7 +407,7 @@ NominationProtocol::getNewValueFromNomination(SCPNomination const& nom)
                 }
             }
         }
-    });
+    }
     return newVote;
 }
 
@@ -378,11 +434,14 @@ NominationProtocol::processEnvelope(SCPEnvelopeWrapperPtr envelope)
         bool modified = false;
         bool newCandidates = false;
 
-        // attempts to promote some of the votes to accepted
+        // attempts to promote some of the votes to accepted, validating
+        // the ones that can be at once
+        auto& pool = mSlot.mValuePool;
+        std::vector<ValuePool::ValueID> acceptable;
         for (auto const& v : nom.votes)
         {
-            auto vw = mSlot.getSCPDriver().wrapValue(v);
-            if (mAccepted.find(vw) != mAccepted.end())
+            auto id = pool.intern(v);
+            if (mAccepted.contains(pool.getWrapper(id)))
             { // v is already accepted
                 continue;
             }
@@ -394,28 +453,36 @@ NominationProtocol::processEnvelope(SCPEnvelopeWrapperPtr envelope)
                                          v) != nom.votes.end());
                         return res;
                     },
-                    std::bind(&NominationProtocol::acceptPredicate, v, _1),
+                    [&v](SCPStatement const& st) {
+                        return acceptPredicate(v, st);
+                    },
                     mLatestNominations))
             {
-                auto vl = validateValue(v);
-                if (vl == SCPDriver::kFullyValidatedValue)
-                {
-                    mAccepted.emplace(vw);
-                    mVotes.emplace(vw);
-                    modified = true;
-                }
-                else
+                acceptable.emplace_back(id);
+            }
+        }
+        std::vector<SCPDriver::ValidationLevel> levels;
+        validateValues(acceptable, levels);
+        for (size_t i = 0; i < acceptable.size(); i++)
+        {
+            auto const& vw = pool.getWrapper(acceptable[i]);
+            if (levels[i] == SCPDriver::kFullyValidatedValue)
+            {
+                mAccepted.insert(vw);
+                mVotes.insert(vw);
+                modified = true;
+            }
+            else
+            {
+                // the value made it pretty far:
+                // see if we can vote for a variation that
+                // we consider valid
+                auto toVote = extractValidValue(vw->getValue());
+                if (toVote)
                 {
-                    // the value made it pretty far:
-                    // see if we can vote for a variation that
-                    // we consider valid
-                    auto toVote = extractValidValue(v);
-                    if (toVote)
+                    if (mVotes.insert(toVote))
                     {
-                        if (mVotes.emplace(toVote).second)
-                        {
-                            modified = true;
-                        }
+                        modified = true;
                     }
                 }
             }
@@ -423,16 +490,17 @@ NominationProtocol::processEnvelope(SCPEnvelopeWrapperPtr envelope)
         // attempts to promote accepted values to candidates
         for (auto const& a : mAccepted)
         {
-            if (mCandidates.find(a) != mCandidates.end())
+            if (mCandidates.contains(a))
             {
                 continue;
             }
             if (mSlot.federatedRatify(
-                    std::bind(&NominationProtocol::acceptPredicate,
-                              a->getValue(), _1),
+                    [&a](SCPStatement const& st) {
+                        return acceptPredicate(a->getValue(), st);
+                    },
                     mLatestNominations))
             {
-                mCandidates.emplace(a);
+                mCandidates.insert(a);
                 newCandidates = true;
             }
         }
@@ -445,7 +513,7 @@ NominationProtocol::processEnvelope(SCPEnvelopeWrapperPtr envelope)
             auto newVote = getNewValueFromNomination(nom);
             if (newVote)
             {
-                mVotes.emplace(newVote);
+                mVotes.insert(newVote);
                 modified = true;
                 mSlot.getSCPDriver().nominatingValue(mSlot.getSlotIndex(),
                                                      newVote->getValue());
@@ -499,7 +567,12 @@ NominationProtocol::nominate(ValueWrapperPtr value, Value const& previousValue,
 
     mNominationStarted = true;
 
-    mPreviousValue = previousValue;
+    if (mPreviousValue != previousValue)
+    {
+        mPreviousValue = previousValue;
+        mHashPrefix.reset();
+        mUpcomingLeaders.clear();
+    }
 
     mRoundNumber++;
     updateRoundLeaders();
@@ -511,8 +584,7 @@ NominationProtocol::nominate(ValueWrapperPtr value, Value const& previousValue,
     if (mRoundLeaders.find(mSlot.getLocalNode()->getNodeID()) !=
         mRoundLeaders.end())
     {
-        auto ins = mVotes.insert(value);
-        if (ins.second)
+        if (mVotes.insert(value))
         {
             updated = true;
             mSlot.getSCPDriver().nominatingValue(mSlot.getSlotIndex(),
@@ -522,11 +594,11 @@ NominationProtocol::nominate(ValueWrapperPtr value, Value const& previousValue,
     // add a few more values from other leaders
     for (auto const& leader : mRoundLeaders)
     {
-        auto it = mLatestNominations.find(leader);
-        if (it != mLatestNominations.end())
+        auto const& env = mLatestNominations.get(leader);
+        if (env)
         {
             auto lnmV = getNewValueFromNomination(
-                it->second->getStatement().pledges.nominate());
+                env->getStatement().pledges.nominate());
             if (lnmV)
             {
                 mVotes.insert(lnmV);
@@ -556,6 +628,9 @@ NominationProtocol::nominate(ValueWrapperPtr value, Value const& previousValue,
         CLOG(DEBUG, "SCP") << "NominationProtocol::nominate (SKIPPED)";
     }
 
+    // so that the timeout does not need to hash anything
+    precomputeRoundLeaders();
+
     return updated;
 }
 
@@ -614,11 +689,11 @@ NominationProtocol::setStateFromEnvelope(SCPEnvelopeWrapperPtr e)
     auto const& nom = e->getStatement().pledges.nominate();
     for (auto const& a : nom.accepted)
     {
-        mAccepted.emplace(mSlot.getSCPDriver().wrapValue(a));
+        mAccepted.insert(mSlot.mValuePool.wrap(a));
     }
     for (auto const& v : nom.votes)
     {
-        mVotes.emplace(mSlot.getSCPDriver().wrapValue(v));
+        mVotes.insert(mSlot.mValuePool.wrap(v));
     }
 
     mLastEnvelope = e;
@@ -646,10 +721,10 @@ NominationProtocol::processCurrentState(
 SCPEnvelope const*
 NominationProtocol::getLatestMessage(NodeID const& id) const
 {
-    auto it = mLatestNominations.find(id);
-    if (it != mLatestNominations.end())
+    auto const& env = mLatestNominations.get(id);
+    if (env)
     {
-        return &it->second->getEnvelope();
+        return &env->getEnvelope();
     }
     return nullptr;
 }
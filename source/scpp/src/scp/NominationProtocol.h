@@ -5,26 +5,32 @@
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
 #include "lib/json/json-forwards.h"
+#include "scp/EnvelopeTable.h"
 #include "scp/SCP.h"
+#include "scp/ValuePool.h"
 #include <functional>
 #include <memory>
 #include <set>
 #include <string>
 #include <utility>
+#include <vector>
 
 namespace stellar
 {
 class NominationProtocol
 {
+    // uses the ordering of statements
+    friend class EnvelopeInbox;
+
   protected:
     Slot& mSlot;
 
     int32 mRoundNumber;
 
-    ValueWrapperPtrSet mVotes;                                  // X
-    ValueWrapperPtrSet mAccepted;                               // Y
-    ValueWrapperPtrSet mCandidates;                             // Z
-    std::map<NodeID, SCPEnvelopeWrapperPtr> mLatestNominations; // N
+    ValueWrapperPtrSet mVotes;         // X
+    ValueWrapperPtrSet mAccepted;      // Y
+    ValueWrapperPtrSet mCandidates;    // Z
+    EnvelopeTable mLatestNominations;  // N
 
     SCPEnvelopeWrapperPtr mLastEnvelope; // last envelope emitted by this node
 
@@ -40,6 +46,23 @@ class NominationProtocol
     // the value from the previous slot
     Value mPreviousValue;
 
+    // state of the hashes of the slot after the slot index and
+    // mPreviousValue, set on first use
+    std::unique_ptr<HashState> mHashPrefix;
+
+    // Nodes with the top priority in the rounds computed ahead of their
+    // timeout, for the current previous value and quorum set version
+    struct RoundLeaders
+    {
+        int32 mRound;
+        std::set<NodeID> mLeaders;
+    };
+    std::vector<RoundLeaders> mUpcomingLeaders;
+    uint64 mLeadersQSetVersion;
+
+    // number of rounds `precomputeRoundLeaders` looks ahead at most
+    static int32 const MAX_ROUNDS_AHEAD;
+
     bool isNewerStatement(NodeID const& nodeID, SCPNomination const& st);
     static bool isNewerStatement(SCPNomination const& oldst,
                                  SCPNomination const& st);
@@ -53,6 +76,11 @@ class NominationProtocol
     SCPDriver::ValidationLevel validateValue(Value const& v);
     ValueWrapperPtr extractValidValue(Value const& value);
 
+    // validates the values of `ids` with a single call to
+    // `SCPDriver::validateValues`, setting `levels` to the level of each
+    void validateValues(std::vector<ValuePool::ValueID> const& ids,
+                        std::vector<SCPDriver::ValidationLevel>& levels);
+
     bool isSane(SCPStatement const& st);
 
     void recordEnvelope(SCPEnvelopeWrapperPtr env);
@@ -69,14 +97,26 @@ class NominationProtocol
     // updates the set of nodes that have priority over the others
     void updateRoundLeaders();
 
-    // computes Gi(isPriority?P:N, prevValue, mRoundNumber, nodeID)
+    // returns the nodes with the top priority in `round`, from
+    // mUpcomingLeaders if it was computed ahead
+    std::set<NodeID> const& getRoundLeaders(int32 round);
+
+    // computes the leaders of the rounds the next call to
+    // `updateRoundLeaders` is going to go through
+    void precomputeRoundLeaders();
+
+    // returns mHashPrefix, computing it if needed
+    HashState const& getHashPrefix();
+
+    // computes Gi(isPriority?P:N, prevValue, round, nodeID)
     // from the paper
-    uint64 hashNode(bool isPriority, NodeID const& nodeID);
+    uint64 hashNode(int32 round, bool isPriority, NodeID const& nodeID);
 
     // computes Gi(K, prevValue, mRoundNumber, value)
     uint64 hashValue(Value const& value);
 
-    uint64 getNodePriority(NodeID const& nodeID, SCPQuorumSet const& qset);
+    // priority of the node with the given weight in `round`
+    uint64 getNodePriority(int32 round, NodeID const& nodeID, uint64 weight);
 
     // returns the highest value that we don't have yet, that we should
     // vote for, extracted from a nomination.
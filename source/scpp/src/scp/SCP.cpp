@@ -20,12 +20,23 @@ namespace stellar
 
 SCP::SCP(SCPDriver& driver, NodeID const& nodeID, bool isValidator,
          SCPQuorumSet const& qSetLocal)
-    : mDriver(driver)
+    : mDriver(driver), mHistoryMode(HISTORY_FULL), mHistoryLimit(0)
 {
     mLocalNode =
         std::make_shared<LocalNode>(nodeID, isValidator, qSetLocal, driver);
 }
 
+void
+SCP::setStatementHistory(StatementHistory mode, size_t limit)
+{
+    if (mode == HISTORY_BOUNDED && limit == 0)
+    {
+        mode = HISTORY_OFF;
+    }
+    mHistoryMode = mode;
+    mHistoryLimit = mode == HISTORY_BOUNDED ? limit : 0;
+}
+
 SCP::EnvelopeState
 SCP::receiveEnvelope(SCPEnvelopeWrapperPtr envelope)
 {
@@ -33,6 +44,35 @@ SCP::receiveEnvelope(SCPEnvelopeWrapperPtr envelope)
     return getSlot(slotIndex, true)->processEnvelope(envelope, false);
 }
 
+std::vector<SCP::EnvelopeState>
+SCP::receiveEnvelopes(std::vector<SCPEnvelopeWrapperPtr> const& envelopes)
+{
+    std::vector<EnvelopeState> res(envelopes.size(), INVALID);
+
+    // positions of the envelopes of each slot, in order
+    std::map<uint64, std::vector<size_t>> slots;
+    for (size_t i = 0; i < envelopes.size(); i++)
+    {
+        slots[envelopes[i]->getStatement().slotIndex].emplace_back(i);
+    }
+
+    for (auto const& s : slots)
+    {
+        std::vector<SCPEnvelopeWrapperPtr> slotEnvelopes;
+        slotEnvelopes.reserve(s.second.size());
+        for (auto i : s.second)
+        {
+            slotEnvelopes.emplace_back(envelopes[i]);
+        }
+        auto states = getSlot(s.first, true)->processEnvelopes(slotEnvelopes);
+        for (size_t i = 0; i < states.size(); i++)
+        {
+            res[s.second[i]] = states[i];
+        }
+    }
+    return res;
+}
+
 bool
 SCP::nominate(uint64 slotIndex, ValueWrapperPtr value,
               Value const& previousValue)
@@ -78,11 +118,51 @@ SCP::changeNodeID(NodeID const& id)
 void
 SCP::purgeSlots(uint64 maxSlotIndex)
 {
-    auto it = mKnownSlots.begin();
-    while (it != mKnownSlots.end() && it->first < maxSlotIndex)
+    mKnownSlots.purge(maxSlotIndex);
+}
+
+void
+SCP::invalidateValues(uint64 slotIndex, bool all)
+{
+    auto slot = getSlot(slotIndex, false);
+    if (slot)
+    {
+        slot->mValuePool.invalidate(all);
+    }
+}
+
+SCPQuorumSetPtr const&
+SCP::getSingletonQSet(NodeID const& nodeID)
+{
+    auto& qSet = mSingletonQSets[nodeID];
+    if (!qSet)
+    {
+        qSet = LocalNode::getSingletonQSet(nodeID);
+    }
+    return qSet;
+}
+
+SCPQuorumSetPtr const&
+SCP::getQSet(NodeID const& nodeID)
+{
+    auto it = mQSets.find(nodeID);
+    if (it == mQSets.end())
     {
-        it = mKnownSlots.erase(it);
+        auto qSet = mDriver.getQSet(nodeID);
+        if (!qSet)
+        {
+            static SCPQuorumSetPtr const noQSet;
+            return noQSet;
+        }
+        it = mQSets.emplace(nodeID, std::move(qSet)).first;
     }
+    return it->second;
+}
+
+void
+SCP::invalidateQuorumSets()
+{
+    mQSets.clear();
 }
 
 std::shared_ptr<LocalNode>
@@ -94,19 +174,11 @@ SCP::getLocalNode()
 std::shared_ptr<Slot>
 SCP::getSlot(uint64 slotIndex, bool create)
 {
-    std::shared_ptr<Slot> res;
-    auto it = mKnownSlots.find(slotIndex);
-    if (it == mKnownSlots.end())
+    std::shared_ptr<Slot> res = mKnownSlots.get(slotIndex);
+    if (!res && create)
     {
-        if (create)
-        {
-            res = std::make_shared<Slot>(slotIndex, *this);
-            mKnownSlots[slotIndex] = res;
-        }
-    }
-    else
-    {
-        res = it->second;
+        res = std::make_shared<Slot>(slotIndex, *this);
+        mKnownSlots.set(slotIndex, res);
     }
     return res;
 }
@@ -115,13 +187,16 @@ Json::Value
 SCP::getJsonInfo(size_t limit, bool fullKeys)
 {
     Json::Value ret;
-    auto it = mKnownSlots.rbegin();
-    while (it != mKnownSlots.rend() && limit-- != 0)
-    {
-        auto& slot = *(it->second);
-        ret[std::to_string(slot.getSlotIndex())] = slot.getJsonInfo(fullKeys);
-        it++;
-    }
+    mKnownSlots.forEachDescending(
+        UINT64_MAX, [&](uint64, std::shared_ptr<Slot> const& slot) {
+            if (limit-- == 0)
+            {
+                return false;
+            }
+            ret[std::to_string(slot->getSlotIndex())] =
+                slot->getJsonInfo(fullKeys);
+            return true;
+        });
 
     return ret;
 }
@@ -133,12 +208,12 @@ SCP::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys,
     Json::Value ret;
     if (index == 0)
     {
-        for (auto& item : mKnownSlots)
-        {
-            auto& slot = *item.second;
-            ret = slot.getJsonQuorumInfo(id, summary, fullKeys);
-            ret["ledger"] = static_cast<Json::UInt64>(slot.getSlotIndex());
-        }
+        mKnownSlots.forEachAscending(
+            0, [&](uint64, std::shared_ptr<Slot> const& slot) {
+                ret = slot->getJsonQuorumInfo(id, summary, fullKeys);
+                ret["ledger"] = static_cast<Json::UInt64>(slot->getSlotIndex());
+                return true;
+            });
     }
     else
     {
@@ -196,10 +271,11 @@ size_t
 SCP::getCumulativeStatemtCount() const
 {
     size_t c = 0;
-    for (auto const& s : mKnownSlots)
-    {
-        c += s.second->getStatementCount();
-    }
+    mKnownSlots.forEachAscending(
+        0, [&](uint64, std::shared_ptr<Slot> const& slot) {
+            c += slot->getStatementCount();
+            return true;
+        });
     return c;
 }
 
@@ -246,53 +322,41 @@ void
 SCP::processSlotsAscendingFrom(uint64 startingSlot,
                                std::function<bool(uint64)> const& f)
 {
-    for (auto iter = mKnownSlots.lower_bound(startingSlot);
-         iter != mKnownSlots.end(); ++iter)
-    {
-        if (!f(iter->first))
-        {
-            break;
-        }
-    }
+    mKnownSlots.forEachAscending(
+        startingSlot,
+        [&](uint64 slotIndex, std::shared_ptr<Slot> const&) {
+            return f(slotIndex);
+        });
 }
 
 void
 SCP::processSlotsDescendingFrom(uint64 startingSlot,
                                 std::function<bool(uint64)> const& f)
 {
-    auto iter = mKnownSlots.upper_bound(startingSlot);
-    while (iter != mKnownSlots.begin())
-    {
-        --iter;
-        if (!f(iter->first))
-        {
-            break;
-        }
-    }
+    mKnownSlots.forEachDescending(
+        startingSlot,
+        [&](uint64 slotIndex, std::shared_ptr<Slot> const&) {
+            return f(slotIndex);
+        });
 }
 
 uint64
 SCP::getHighSlotIndex() const
 {
     assert(!empty());
-    auto it = mKnownSlots.end();
-    it--;
-    return it->first;
+    return mKnownSlots.getHighIndex();
 }
 
 SCPEnvelope const*
 SCP::getLatestMessage(NodeID const& id)
 {
-    for (auto it = mKnownSlots.rbegin(); it != mKnownSlots.rend(); it++)
-    {
-        auto slot = it->second;
-        auto res = slot->getLatestMessage(id);
-        if (res != nullptr)
-        {
-            return res;
-        }
-    }
-    return nullptr;
+    SCPEnvelope const* res = nullptr;
+    mKnownSlots.forEachDescending(
+        UINT64_MAX, [&](uint64, std::shared_ptr<Slot> const& slot) {
+            res = slot->getLatestMessage(id);
+            return res == nullptr;
+        });
+    return res;
 }
 
 std::vector<SCPEnvelope>
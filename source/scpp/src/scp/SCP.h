@@ -9,9 +9,13 @@
 #include <map>
 #include <memory>
 #include <set>
+#include <vector>
 
 #include "lib/json/json-forwards.h"
 #include "scp/SCPDriver.h"
+#include "scp/SlotStore.h"
+#include "util/HashOfHash.h"
+#include "util/UnorderedMap.h"
 
 namespace stellar
 {
@@ -50,6 +54,20 @@ class SCP
     // invokes the appropriate methods
     EnvelopeState receiveEnvelope(SCPEnvelopeWrapperPtr envelope);
 
+    // processes a batch of envelopes, slot by slot in increasing order.
+    // Within a slot, the nomination envelopes are processed one by one,
+    // as with `receiveEnvelope`, then the ballot envelopes are all checked,
+    // validated and recorded against the state of the slot before any of
+    // them, and only then does the ballot protocol advance, once for the
+    // batch.
+    // This differs from receiving the envelopes in order: a ballot envelope
+    // is not checked against the state the previous ones lead to, the
+    // intermediate states are neither emitted nor reported to the driver,
+    // and a slot may externalize only once its whole batch is recorded.
+    // returns the state of each envelope, in the same order
+    std::vector<EnvelopeState>
+    receiveEnvelopes(std::vector<SCPEnvelopeWrapperPtr> const& envelopes);
+
     // Submit a value to consider for slotIndex
     // previousValue is the value from slotIndex-1
     bool nominate(uint64 slotIndex, ValueWrapperPtr value,
@@ -79,10 +97,53 @@ class SCP
     Json::Value getJsonQuorumInfo(NodeID const& id, bool summary,
                                   bool fullKeys = false, uint64 index = 0);
 
+    // What the slots keep of the statements they receive, for debugging
+    enum StatementHistory
+    {
+        HISTORY_OFF,     // nothing
+        HISTORY_BOUNDED, // the last statements, up to a limit
+        HISTORY_FULL     // all the statements
+    };
+
+    // sets the history kept by the slots created from now on, `limit` is the
+    // number of statements kept by each slot with HISTORY_BOUNDED
+    void setStatementHistory(StatementHistory mode, size_t limit = 0);
+
+    StatementHistory
+    getStatementHistory() const
+    {
+        return mHistoryMode;
+    }
+
+    size_t
+    getStatementHistoryLimit() const
+    {
+        return mHistoryLimit;
+    }
+
     // Purges all data relative to all the slots whose slotIndex is smaller
     // than the specified `maxSlotIndex`.
     void purgeSlots(uint64 maxSlotIndex);
 
+    // Makes the slot `slotIndex` call `SCPDriver::validateValue` again for
+    // the values it validated as kMaybeValidValue, or all of them if `all`
+    // is set, which the driver must do when it gets the data it was missing
+    // or its validation rules change: the slots validate each value only
+    // once otherwise, unless it was found invalid.
+    void invalidateValues(uint64 slotIndex, bool all = false);
+
+    // returns the quorum set {{nodeID}} used for the nodes that externalized
+    SCPQuorumSetPtr const& getSingletonQSet(NodeID const& nodeID);
+
+    // returns the quorum set of `nodeID` given by `SCPDriver::getQSet`,
+    // kept until `invalidateQuorumSets` is called if it is not null
+    SCPQuorumSetPtr const& getQSet(NodeID const& nodeID);
+
+    // Forgets the quorum sets obtained from `SCPDriver::getQSet`, which the
+    // driver must do when the quorum sets of the nodes change (for example
+    // with the validator set).
+    void invalidateQuorumSets();
+
     // Returns whether the local node is a validator.
     bool isValidator();
 
@@ -143,7 +204,16 @@ class SCP
 
   protected:
     std::shared_ptr<LocalNode> mLocalNode;
-    std::map<uint64, std::shared_ptr<Slot>> mKnownSlots;
+    SlotStore mKnownSlots;
+
+    StatementHistory mHistoryMode;
+    size_t mHistoryLimit;
+
+    // quorum sets used by the federated checks of the slots, so that they
+    // neither build {{X}} nor call the driver for every statement, and the
+    // compiled form of each quorum set is reused
+    UnorderedMap<NodeID, SCPQuorumSetPtr> mSingletonQSets;
+    UnorderedMap<NodeID, SCPQuorumSetPtr> mQSets;
 
     // Slot getter
     std::shared_ptr<Slot> getSlot(uint64 slotIndex, bool create);
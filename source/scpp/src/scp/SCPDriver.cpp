@@ -7,6 +7,7 @@
 #include <algorithm>
 
 #include "crypto/Hex.h"
+#include "crypto/ShortHash.h"
 #include "xdrpp/marshal.h"
 
 namespace stellar
@@ -17,7 +18,8 @@ WrappedValuePtrComparator::operator()(ValueWrapperPtr const& l,
                                       ValueWrapperPtr const& r) const
 {
     assert(l && r);
-    return l->getValue() < r->getValue();
+    // values wrapped by a slot's `ValuePool` share their wrapper
+    return l != r && l->getValue() < r->getValue();
 }
 
 SCPEnvelopeWrapper::SCPEnvelopeWrapper(SCPEnvelope const& e) : mEnvelope(e)
@@ -28,7 +30,14 @@ SCPEnvelopeWrapper::~SCPEnvelopeWrapper()
 {
 }
 
-ValueWrapper::ValueWrapper(Value const& value) : mValue(value)
+ValueWrapper::ValueWrapper(Value const& value)
+    : ValueWrapper(value,
+                   shortHash::computeHash(ByteSlice(value.data(), value.size())))
+{
+}
+
+ValueWrapper::ValueWrapper(Value const& value, uint64 hash)
+    : mValue(value), mHash(hash)
 {
 }
 
@@ -36,6 +45,19 @@ ValueWrapper::~ValueWrapper()
 {
 }
 
+void
+SCPDriver::validateValues(uint64 slotIndex,
+                          std::vector<ValueWrapperPtr> const& values,
+                          bool nomination, std::vector<ValidationLevel>& levels)
+{
+    levels.clear();
+    levels.reserve(values.size());
+    for (auto const& v : values)
+    {
+        levels.emplace_back(validateValue(slotIndex, v->getValue(), nomination));
+    }
+}
+
 SCPEnvelopeWrapperPtr
 SCPDriver::wrapEnvelope(SCPEnvelope const& envelope)
 {
@@ -46,7 +68,14 @@ SCPDriver::wrapEnvelope(SCPEnvelope const& envelope)
 ValueWrapperPtr
 SCPDriver::wrapValue(Value const& value)
 {
-    auto res = std::make_shared<ValueWrapper>(value);
+    return wrapValue(
+        value, shortHash::computeHash(ByteSlice(value.data(), value.size())));
+}
+
+ValueWrapperPtr
+SCPDriver::wrapValue(Value const& value, uint64 hash)
+{
+    auto res = std::make_shared<ValueWrapper>(value, hash);
     return res;
 }
 
@@ -55,16 +84,37 @@ static const uint32 hash_N = 1;
 static const uint32 hash_P = 2;
 static const uint32 hash_K = 3;
 
+void
+SCPDriver::startHash(HashState& state) const
+{
+    state.mParts.clear();
+}
+
+void
+SCPDriver::addToHash(HashState& state, xdr::opaque_vec<> const& part) const
+{
+    state.mParts.emplace_back(part);
+}
+
+Hash
+SCPDriver::finishHash(HashState& state) const
+{
+    return getHashOf(state.mParts);
+}
+
+void
+SCPDriver::startNominationHash(HashState& state, uint64 slotIndex,
+                               Value const& prev) const
+{
+    startHash(state);
+    addToHash(state, xdr::xdr_to_opaque(slotIndex));
+    addToHash(state, xdr::xdr_to_opaque(prev));
+}
+
 uint64
-SCPDriver::hashHelper(
-    uint64 slotIndex, Value const& prev,
-    std::function<void(std::vector<xdr::opaque_vec<>>&)> extra)
-{
-    std::vector<xdr::opaque_vec<>> vals;
-    vals.emplace_back(xdr::xdr_to_opaque(slotIndex));
-    vals.emplace_back(xdr::xdr_to_opaque(prev));
-    extra(vals);
-    Hash t = getHashOf(vals);
+SCPDriver::finishShortHash(HashState& state) const
+{
+    Hash t = finishHash(state);
     uint64 res = 0;
     for (size_t i = 0; i < sizeof(res); i++)
     {
@@ -73,16 +123,24 @@ SCPDriver::hashHelper(
     return res;
 }
 
+uint64
+SCPDriver::computeHashNode(HashState const& prefix, bool isPriority,
+                           int32_t roundNumber, NodeID const& nodeID)
+{
+    HashState state = prefix;
+    addToHash(state, xdr::xdr_to_opaque(isPriority ? hash_P : hash_N));
+    addToHash(state, xdr::xdr_to_opaque(roundNumber));
+    addToHash(state, xdr::xdr_to_opaque(nodeID));
+    return finishShortHash(state);
+}
+
 uint64
 SCPDriver::computeHashNode(uint64 slotIndex, Value const& prev, bool isPriority,
                            int32_t roundNumber, NodeID const& nodeID)
 {
-    return hashHelper(
-        slotIndex, prev, [&](std::vector<xdr::opaque_vec<>>& vals) {
-            vals.emplace_back(xdr::xdr_to_opaque(isPriority ? hash_P : hash_N));
-            vals.emplace_back(xdr::xdr_to_opaque(roundNumber));
-            vals.emplace_back(xdr::xdr_to_opaque(nodeID));
-        });
+    HashState prefix;
+    startNominationHash(prefix, slotIndex, prev);
+    return computeHashNode(prefix, isPriority, roundNumber, nodeID);
 }
 
 Hash
@@ -91,16 +149,24 @@ SCPDriver::getHashOfQuorum(SCPQuorumSet const& qSet) const
     return getHashOf({xdr::xdr_to_opaque(qSet)});
 }
 
+uint64
+SCPDriver::computeValueHash(HashState const& prefix, int32_t roundNumber,
+                            Value const& value)
+{
+    HashState state = prefix;
+    addToHash(state, xdr::xdr_to_opaque(hash_K));
+    addToHash(state, xdr::xdr_to_opaque(roundNumber));
+    addToHash(state, xdr::xdr_to_opaque(value));
+    return finishShortHash(state);
+}
+
 uint64
 SCPDriver::computeValueHash(uint64 slotIndex, Value const& prev,
                             int32_t roundNumber, Value const& value)
 {
-    return hashHelper(slotIndex, prev,
-                      [&](std::vector<xdr::opaque_vec<>>& vals) {
-                          vals.emplace_back(xdr::xdr_to_opaque(hash_K));
-                          vals.emplace_back(xdr::xdr_to_opaque(roundNumber));
-                          vals.emplace_back(xdr::xdr_to_opaque(value));
-                      });
+    HashState prefix;
+    startNominationHash(prefix, slotIndex, prev);
+    return computeValueHash(prefix, roundNumber, value);
 }
 
 static const int MAX_TIMEOUT_SECONDS = (30 * 60);
@@ -4,12 +4,14 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include "scp/ValueWrapperPtrSet.h"
 #include "util/NonCopyable.h"
 #include <chrono>
 #include <functional>
 #include <map>
 #include <memory>
 #include <set>
+#include <vector>
 
 #include "xdr/Stellar-SCP.h"
 
@@ -18,9 +20,13 @@ namespace stellar
 class ValueWrapper : public NonMovableOrCopyable
 {
     Value const mValue;
+    // short hash of the value, for `ValueWrapperPtrSet` and `ValuePool`
+    uint64 const mHash;
 
   public:
     explicit ValueWrapper(Value const& value);
+    // `hash` is the short hash of `value`, for callers that already know it
+    ValueWrapper(Value const& value, uint64 hash);
     virtual ~ValueWrapper();
 
     Value const&
@@ -28,6 +34,12 @@ class ValueWrapper : public NonMovableOrCopyable
     {
         return mValue;
     }
+
+    uint64
+    getHash() const
+    {
+        return mHash;
+    }
 };
 
 typedef std::shared_ptr<SCPQuorumSet> SCPQuorumSetPtr;
@@ -39,8 +51,6 @@ class WrappedValuePtrComparator
     bool operator()(ValueWrapperPtr const& l, ValueWrapperPtr const& r) const;
 };
 
-typedef std::set<ValueWrapperPtr, WrappedValuePtrComparator> ValueWrapperPtrSet;
-
 class SCPEnvelopeWrapper : public NonMovableOrCopyable
 {
     SCPEnvelope const mEnvelope;
@@ -63,6 +73,18 @@ class SCPEnvelopeWrapper : public NonMovableOrCopyable
 
 typedef std::shared_ptr<SCPEnvelopeWrapper> SCPEnvelopeWrapperPtr;
 
+// The state of a hash computed by `SCPDriver`, as parts are added to it.
+// Copying it forks the hash, so that the parts common to several hashes are
+// only processed once.
+struct HashState
+{
+    // for drivers that compute the hash incrementally, large enough for the
+    // state of a BLAKE2b hash in libsodium
+    alignas(64) unsigned char mBuffer[384];
+    // for the others, the parts added so far
+    std::vector<xdr::opaque_vec<>> mParts;
+};
+
 class SCPDriver
 {
   public:
@@ -77,7 +99,10 @@ class SCPDriver
     virtual SCPEnvelopeWrapperPtr wrapEnvelope(SCPEnvelope const& envelope);
 
     // ValueWrapperPtr factory
-    virtual ValueWrapperPtr wrapValue(Value const& value);
+    ValueWrapperPtr wrapValue(Value const& value);
+    // same, with `hash` the short hash of `value`: `ValuePool` computes it
+    // to look values up, so that new values are not hashed again
+    virtual ValueWrapperPtr wrapValue(Value const& value, uint64 hash);
 
     // Retrieves the quorum set configuration for the given node ID
     //
@@ -123,6 +148,16 @@ class SCPDriver
         return kMaybeValidValue;
     }
 
+    // `validateValues` sets `levels` to what `validateValue` returns for each
+    // of `values`. The protocols pass it the values of the envelopes they are
+    // about to process that were not validated yet, so that a driver can
+    // validate them concurrently.
+    // The default implementation calls `validateValue` for each value.
+    virtual void validateValues(uint64 slotIndex,
+                                std::vector<ValueWrapperPtr> const& values,
+                                bool nomination,
+                                std::vector<ValidationLevel>& levels);
+
     // `extractValidValue` transforms the value, if possible to a different
     // value that the local node would agree to (fully validated).
     // This is used during nomination when encountering an invalid value (ie
@@ -152,16 +187,45 @@ class SCPDriver
     virtual Hash
     getHashOfQuorum(SCPQuorumSet const& qSet) const;
 
+    // `startHash`, `addToHash` and `finishHash` compute the hash
+    // `getHashOf` returns as its parts are added.
+    // The default keeps the parts in `HashState::mParts` and passes them to
+    // `getHashOf`. Drivers whose hash function can be computed incrementally
+    // override all three and keep their state in `HashState::mBuffer`, so
+    // that the nomination protocol processes the prefix of its hashes once
+    // per slot.
+    virtual void startHash(HashState& state) const;
+    virtual void addToHash(HashState& state,
+                           xdr::opaque_vec<> const& part) const;
+    virtual Hash finishHash(HashState& state) const;
+
+    // `startNominationHash` sets `state` to the state of the hashes of the
+    // nomination protocol for `slotIndex` after their common prefix, to
+    // pass to `computeHashNode` and `computeValueHash`
+    void startNominationHash(HashState& state, uint64 slotIndex,
+                             Value const& prev) const;
+
     // `computeHashNode` is used by the nomination protocol to
     // randomize the order of messages between nodes.
-    virtual uint64 computeHashNode(uint64 slotIndex, Value const& prev,
-                                   bool isPriority, int32_t roundNumber,
-                                   NodeID const& nodeID);
+    // `prefix` is the state `startNominationHash` set, it is not modified.
+    // The leaders of the next rounds are computed ahead of their timeout,
+    // so `roundNumber` can be past the round the slot is in: overrides must
+    // not take it as the current round.
+    virtual uint64 computeHashNode(HashState const& prefix, bool isPriority,
+                                   int32_t roundNumber, NodeID const& nodeID);
+    // same, from the slot index and previous value
+    uint64 computeHashNode(uint64 slotIndex, Value const& prev,
+                           bool isPriority, int32_t roundNumber,
+                           NodeID const& nodeID);
 
     // `computeValueHash` is used by the nomination protocol to
     // randomize the relative order between values.
-    virtual uint64 computeValueHash(uint64 slotIndex, Value const& prev,
+    // `prefix` is the state `startNominationHash` set, it is not modified.
+    virtual uint64 computeValueHash(HashState const& prefix,
                                     int32_t roundNumber, Value const& value);
+    // same, from the slot index and previous value
+    uint64 computeValueHash(uint64 slotIndex, Value const& prev,
+                            int32_t roundNumber, Value const& value);
 
     // `combineCandidates` computes the composite value based off a list
     // of candidate values.
@@ -241,8 +305,7 @@ class SCPDriver
     }
 
   private:
-    uint64
-    hashHelper(uint64 slotIndex, Value const& prev,
-               std::function<void(std::vector<xdr::opaque_vec<>>&)> extra);
+    // returns the first 8 bytes of the hash of `state` as an integer
+    uint64 finishShortHash(HashState& state) const;
 };
 }
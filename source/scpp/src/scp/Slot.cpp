@@ -5,6 +5,7 @@
 #include "Slot.h"
 
 #include "crypto/Hex.h"
+#include "crypto/ShortHash.h"
 #include "lib/json/json.h"
 #include "main/ErrorMessages.h"
 #include "scp/LocalNode.h"
@@ -18,13 +19,16 @@
 
 namespace stellar
 {
-using namespace std::placeholders;
-
 Slot::Slot(uint64 slotIndex, SCP& scp)
     : mSlotIndex(slotIndex)
     , mSCP(scp)
+    , mValuePool(scp.getDriver(), mArena)
     , mBallotProtocol(*this)
     , mNominationProtocol(*this)
+    , mStatementsHistory(ArenaAllocator<HistoricalStatement>(mArena))
+    , mHistoryStart(0)
+    , mHistoryMode(scp.getStatementHistory())
+    , mHistoryLimit(scp.getStatementHistoryLimit())
     , mFullyValidated(scp.getLocalNode()->isValidator())
     , mGotVBlocking(false)
 {
@@ -117,8 +121,23 @@ Slot::getExternalizingState() const
 void
 Slot::recordStatement(SCPStatement const& st)
 {
-    mStatementsHistory.emplace_back(
-        HistoricalStatement{std::time(nullptr), st, mFullyValidated});
+    if (mHistoryMode != SCP::HISTORY_OFF)
+    {
+        HistoricalStatement item{std::time(nullptr), st.nodeID,
+                                 st.pledges.type(),
+                                 shortHash::xdrComputeHash(st),
+                                 mFullyValidated};
+        if (mHistoryMode == SCP::HISTORY_BOUNDED &&
+            mStatementsHistory.size() == mHistoryLimit)
+        {
+            mStatementsHistory[mHistoryStart] = item;
+            mHistoryStart = (mHistoryStart + 1) % mHistoryLimit;
+        }
+        else
+        {
+            mStatementsHistory.emplace_back(item);
+        }
+    }
     CLOG(DEBUG, "SCP") << "new statement: "
                        << " i: " << getSlotIndex()
                        << " st: " << mSCP.envToStr(st, false) << " validated: "
@@ -170,6 +189,66 @@ Slot::processEnvelope(SCPEnvelopeWrapperPtr envelope, bool self)
     return res;
 }
 
+std::vector<SCP::EnvelopeState>
+Slot::processEnvelopes(std::vector<SCPEnvelopeWrapperPtr> const& envelopes)
+{
+    std::vector<SCP::EnvelopeState> res(envelopes.size(), SCP::INVALID);
+    std::vector<SCPEnvelopeWrapperPtr> ballots;
+    std::vector<size_t> ballotIndexes;
+    bool newNode = false;
+
+    for (size_t i = 0; i < envelopes.size(); i++)
+    {
+        auto const& st = envelopes[i]->getStatement();
+        if (st.pledges.type() == SCPStatementType::SCP_ST_NOMINATE)
+        {
+            res[i] = processEnvelope(envelopes[i], false);
+        }
+        else
+        {
+            newNode = newNode || getLatestMessage(st.nodeID) == nullptr;
+            ballots.emplace_back(envelopes[i]);
+            ballotIndexes.emplace_back(i);
+        }
+    }
+
+    if (ballots.empty())
+    {
+        return res;
+    }
+
+    if (Logging::logTrace("SCP"))
+        CLOG(TRACE, "SCP") << "Slot::processEnvelopes"
+                           << " i: " << getSlotIndex()
+                           << " ballot envelopes: " << ballots.size();
+
+    try
+    {
+        auto states = mBallotProtocol.processEnvelopes(ballots);
+        for (size_t i = 0; i < states.size(); i++)
+        {
+            res[ballotIndexes[i]] = states[i];
+        }
+
+        if (newNode)
+        {
+            maybeSetGotVBlocking();
+        }
+    }
+    catch (...)
+    {
+        CLOG(FATAL, "SCP") << "SCP context:";
+        CLOG(FATAL, "SCP") << getJsonInfo().toStyledString();
+        CLOG(FATAL, "SCP") << "Exception processing SCP messages at "
+                           << mSlotIndex << ", batch of " << ballots.size()
+                           << " ballot envelopes";
+        CLOG(FATAL, "SCP") << REPORT_INTERNAL_BUG;
+
+        throw;
+    }
+    return res;
+}
+
 bool
 Slot::abandonBallot()
 {
@@ -248,21 +327,19 @@ Slot::getStatementValues(SCPStatement const& st)
     return res;
 }
 
-SCPQuorumSetPtr
+SCPQuorumSetPtr const&
 Slot::getQuorumSetFromStatement(SCPStatement const& st)
 {
-    SCPQuorumSetPtr res;
     SCPStatementType t = st.pledges.type();
 
     if (t == SCP_ST_EXTERNALIZE)
     {
-        res = LocalNode::getSingletonQSet(st.nodeID);
+        return mSCP.getSingletonQSet(st.nodeID);
     }
     else
     {
-        res = getSCPDriver().getQSet(st.nodeID);
+        return mSCP.getQSet(st.nodeID);
     }
-    return res;
 }
 
 Json::Value
@@ -272,17 +349,21 @@ Slot::getJsonInfo(bool fullKeys)
     std::map<NodeID, SCPQuorumSetPtr> qSetsUsed;
 
     int count = 0;
-    for (auto const& item : mStatementsHistory)
+    for (size_t i = 0; i < mStatementsHistory.size(); i++)
     {
+        auto const& item =
+            mStatementsHistory[(mHistoryStart + i) % mStatementsHistory.size()];
         Json::Value& v = ret["statements"][count++];
         v.append((Json::UInt64)item.mWhen);
-        v.append(mSCP.envToStr(item.mStatement, fullKeys));
+        v.append(getSCPDriver().toStrKey(item.mNodeID, fullKeys));
+        v.append(xdr::xdr_traits<SCPStatementType>::enum_name(item.mType));
+        v.append((Json::UInt64)item.mHash);
         v.append(item.mValidated);
 
-        auto qSet = getSCPDriver().getQSet(item.mStatement.nodeID);
+        auto qSet = getSCPDriver().getQSet(item.mNodeID);
         if (qSet)
         {
-            qSetsUsed.insert(std::make_pair(item.mStatement.nodeID, qSet));
+            qSetsUsed.insert(std::make_pair(item.mNodeID, qSet));
         }
     }
 
@@ -305,28 +386,23 @@ Slot::getJsonQuorumInfo(NodeID const& id, bool summary, bool fullKeys)
 }
 
 bool
-Slot::federatedAccept(StatementPredicate voted, StatementPredicate accepted,
-                      std::map<NodeID, SCPEnvelopeWrapperPtr> const& envs)
+Slot::federatedAccept(BitSet const& voted, BitSet const& accepted,
+                      EnvelopeTable const& envs)
 {
     // Checks if the nodes that claimed to accept the statement form a
     // v-blocking set
-    if (LocalNode::isVBlocking(getLocalNode()->getQuorumSet(), envs, accepted))
+    if (LocalNode::isVBlocking(*getLocalNode(), envs, accepted))
     {
         return true;
     }
 
     // Checks if the set of nodes that accepted or voted for it form a quorum
-
-    auto ratifyFilter = [&](SCPStatement const& st) {
-        bool res;
-        res = accepted(st) || voted(st);
-        return res;
-    };
-
     if (LocalNode::isQuorum(
-            getLocalNode()->getQuorumSet(), envs,
-            std::bind(&Slot::getQuorumSetFromStatement, this, _1),
-            ratifyFilter))
+            *getLocalNode(), envs,
+            [this](SCPStatement const& st) -> SCPQuorumSetPtr const& {
+                return getQuorumSetFromStatement(st);
+            },
+            voted | accepted))
     {
         return true;
     }
@@ -335,12 +411,14 @@ Slot::federatedAccept(StatementPredicate voted, StatementPredicate accepted,
 }
 
 bool
-Slot::federatedRatify(StatementPredicate voted,
-                      std::map<NodeID, SCPEnvelopeWrapperPtr> const& envs)
+Slot::federatedRatify(BitSet const& voted, EnvelopeTable const& envs)
 {
     return LocalNode::isQuorum(
-        getLocalNode()->getQuorumSet(), envs,
-        std::bind(&Slot::getQuorumSetFromStatement, this, _1), voted);
+        *getLocalNode(), envs,
+        [this](SCPStatement const& st) -> SCPQuorumSetPtr const& {
+            return getQuorumSetFromStatement(st);
+        },
+        voted);
 }
 
 std::shared_ptr<LocalNode>
@@ -9,6 +9,7 @@
 #include "NominationProtocol.h"
 #include "lib/json/json-forwards.h"
 #include "scp/SCP.h"
+#include "scp/SlotArena.h"
 #include <functional>
 #include <memory>
 #include <set>
@@ -31,19 +32,42 @@ class Slot : public std::enable_shared_from_this<Slot>
     const uint64 mSlotIndex; // the index this slot is tracking
     SCP& mSCP;
 
+    // memory of the structures of the slot that never outlive it, declared
+    // first so that it is released last
+    SlotArena mArena;
+
+    // dense numbering of the nodes seen in this slot, shared by the
+    // envelope tables of both protocols
+    NodeIndex mNodeIndex;
+
+    // the values seen in this slot, wrapped once and numbered for the
+    // structures indexed by value
+    ValuePool mValuePool;
+
     BallotProtocol mBallotProtocol;
     NominationProtocol mNominationProtocol;
 
-    // keeps track of all statements seen so far for this slot.
-    // it is used for debugging purpose
+    // keeps track of the statements seen so far for this slot, as set by
+    // `SCP::setStatementHistory`.
+    // it is used for debugging purpose, so only a summary of each statement
+    // is kept rather than a copy of its values
     struct HistoricalStatement
     {
         time_t mWhen;
-        SCPStatement mStatement;
+        NodeID mNodeID;
+        SCPStatementType mType;
+        // short hash of the statement
+        uint64 mHash;
         bool mValidated;
     };
 
-    std::vector<HistoricalStatement> mStatementsHistory;
+    // with a bounded history, used as a ring buffer starting at
+    // `mHistoryStart` once full
+    std::vector<HistoricalStatement, ArenaAllocator<HistoricalStatement>>
+        mStatementsHistory;
+    size_t mHistoryStart;
+    SCP::StatementHistory mHistoryMode;
+    size_t mHistoryLimit;
 
     // true if the Slot was fully validated
     bool mFullyValidated;
@@ -114,6 +138,14 @@ class Slot : public std::enable_shared_from_this<Slot>
     SCP::EnvelopeState processEnvelope(SCPEnvelopeWrapperPtr envelope,
                                        bool self);
 
+    // Process envelopes received for this slot as a batch.
+    // Nomination envelopes are processed in order, while ballot envelopes
+    // are all recorded before the ballot protocol advances (see
+    // `BallotProtocol::processEnvelopes`).
+    // Returns the state of each envelope.
+    std::vector<SCP::EnvelopeState>
+    processEnvelopes(std::vector<SCPEnvelopeWrapperPtr> const& envelopes);
+
     bool abandonBallot();
 
     // bumps the ballot based on the local state and the value passed in:
@@ -162,7 +194,7 @@ class Slot : public std::enable_shared_from_this<Slot>
 
     // returns the QuorumSet that should be used for a node given the
     // statement (singleton for externalize)
-    SCPQuorumSetPtr getQuorumSetFromStatement(SCPStatement const& st);
+    SCPQuorumSetPtr const& getQuorumSetFromStatement(SCPStatement const& st);
 
     // wraps a statement in an envelope (sign it, etc)
     SCPEnvelope createEnvelope(SCPStatement const& statement);
@@ -171,12 +203,29 @@ class Slot : public std::enable_shared_from_this<Slot>
 
     // returns true if the statement defined by voted and accepted
     // should be accepted
-    bool federatedAccept(StatementPredicate voted, StatementPredicate accepted,
-                         std::map<NodeID, SCPEnvelopeWrapperPtr> const& envs);
+    // (`voted` and `accepted` are callables taking a `SCPStatement const&`)
+    template <typename Voted, typename Accepted>
+    bool
+    federatedAccept(Voted const& voted, Accepted const& accepted,
+                    EnvelopeTable const& envs)
+    {
+        return federatedAccept(envs.filter(voted), envs.filter(accepted),
+                               envs);
+    }
     // returns true if the statement defined by voted
     // is ratified
-    bool federatedRatify(StatementPredicate voted,
-                         std::map<NodeID, SCPEnvelopeWrapperPtr> const& envs);
+    template <typename Voted>
+    bool
+    federatedRatify(Voted const& voted, EnvelopeTable const& envs)
+    {
+        return federatedRatify(envs.filter(voted), envs);
+    }
+
+    // same, with the nodes that voted for and accepted the statement given by
+    // their bits in the index of `envs`
+    bool federatedAccept(BitSet const& voted, BitSet const& accepted,
+                         EnvelopeTable const& envs);
+    bool federatedRatify(BitSet const& voted, EnvelopeTable const& envs);
 
     std::shared_ptr<LocalNode> getLocalNode();
 
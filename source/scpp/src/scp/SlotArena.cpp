@@ -0,0 +1,97 @@
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "scp/SlotArena.h"
+#include "util/GlobalChecks.h"
+
+#include <algorithm>
+#include <new>
+
+namespace stellar
+{
+size_t const SlotArena::ALIGNMENT;
+size_t const SlotArena::BLOCK_SIZE;
+size_t const SlotArena::MAX_POOLED;
+
+SlotArena::SlotArena() : mCurrent(nullptr), mEnd(nullptr)
+{
+    mFree.fill(nullptr);
+}
+
+SlotArena::~SlotArena()
+{
+    for (auto block : mBlocks)
+    {
+        ::operator delete(block);
+    }
+}
+
+size_t
+SlotArena::roundUp(size_t size)
+{
+    return size == 0 ? ALIGNMENT : (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+void*
+SlotArena::allocate(size_t size)
+{
+    size = roundUp(size);
+
+    if (size <= MAX_POOLED)
+    {
+        auto& free = mFree[size / ALIGNMENT - 1];
+        if (free)
+        {
+            auto res = free;
+            free = res->mNext;
+            return res;
+        }
+    }
+
+    // large blocks get their own memory, so they don't waste the rest of the
+    // current block
+    if (size > BLOCK_SIZE / 4)
+    {
+        mBlocks.reserve(mBlocks.size() + 1);
+        auto res = ::operator new(size);
+        mBlocks.emplace_back(res);
+        return res;
+    }
+
+    if (static_cast<size_t>(mEnd - mCurrent) < size)
+    {
+        mBlocks.reserve(mBlocks.size() + 1);
+        mCurrent = static_cast<char*>(::operator new(BLOCK_SIZE));
+        mEnd = mCurrent + BLOCK_SIZE;
+        mBlocks.emplace_back(mCurrent);
+    }
+    auto res = mCurrent;
+    mCurrent += size;
+    return res;
+}
+
+void
+SlotArena::deallocate(void* p, size_t size)
+{
+    size = roundUp(size);
+    if (size <= MAX_POOLED)
+    {
+        auto& free = mFree[size / ALIGNMENT - 1];
+        auto block = static_cast<FreeBlock*>(p);
+        block->mNext = free;
+        free = block;
+    }
+    else if (size > BLOCK_SIZE / 4)
+    {
+        // large blocks are released right away, so that a growing vector
+        // does not keep its previous buffers until the slot is destroyed
+        auto it = std::find(mBlocks.rbegin(), mBlocks.rend(), p);
+        dbgAssert(it != mBlocks.rend());
+        ::operator delete(p);
+        *it = mBlocks.back();
+        mBlocks.pop_back();
+    }
+}
+}
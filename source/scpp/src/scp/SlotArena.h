@@ -0,0 +1,105 @@
+#pragma once
+
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "util/NonCopyable.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace stellar
+{
+// Memory of the structures that a slot owns and that never outlive it.
+//
+// Memory is carved from large blocks that are all released at once when the
+// slot is destroyed, instead of going through the heap for every map node or
+// array of the per-statement structures. Small blocks are recycled through
+// free lists by size, so structures that are updated for every statement do
+// not grow the arena. Large blocks get their own memory and are released
+// as soon as they are deallocated; the medium ones are only released with
+// the arena.
+// Wrappers of values and envelopes are shared outside of the slot, so they
+// do not use the arena.
+class SlotArena : public NonMovableOrCopyable
+{
+  public:
+    static size_t const ALIGNMENT = alignof(std::max_align_t);
+
+  private:
+    static size_t const BLOCK_SIZE = 16 * 1024;
+    static size_t const MAX_POOLED = 256;
+
+    struct FreeBlock
+    {
+        FreeBlock* mNext;
+    };
+
+    std::vector<void*> mBlocks;
+    char* mCurrent;
+    char* mEnd;
+    // free lists of the small blocks by size, in units of ALIGNMENT
+    std::array<FreeBlock*, MAX_POOLED / ALIGNMENT> mFree;
+
+    static size_t roundUp(size_t size);
+
+  public:
+    SlotArena();
+    ~SlotArena();
+
+    void* allocate(size_t size);
+    void deallocate(void* p, size_t size);
+};
+
+// Standard allocator using a `SlotArena`
+template <typename T> class ArenaAllocator
+{
+    static_assert(alignof(T) <= SlotArena::ALIGNMENT,
+                  "over-aligned types are not supported by the arena");
+
+    SlotArena* mArena;
+
+    template <typename U> friend class ArenaAllocator;
+
+  public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(SlotArena& arena) : mArena(&arena)
+    {
+    }
+
+    template <typename U>
+    ArenaAllocator(ArenaAllocator<U> const& other) : mArena(other.mArena)
+    {
+    }
+
+    T*
+    allocate(size_t n)
+    {
+        return static_cast<T*>(mArena->allocate(n * sizeof(T)));
+    }
+
+    void
+    deallocate(T* p, size_t n)
+    {
+        mArena->deallocate(p, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool
+    operator==(ArenaAllocator<U> const& other) const
+    {
+        return mArena == other.mArena;
+    }
+
+    template <typename U>
+    bool
+    operator!=(ArenaAllocator<U> const& other) const
+    {
+        return mArena != other.mArena;
+    }
+};
+}
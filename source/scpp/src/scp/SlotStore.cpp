@@ -0,0 +1,118 @@
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "scp/SlotStore.h"
+#include "scp/Slot.h"
+#include "util/GlobalChecks.h"
+
+namespace stellar
+{
+size_t const SlotStore::CAPACITY;
+
+SlotStore::SlotStore() : mRing(CAPACITY), mRingCount(0), mBase(0)
+{
+}
+
+SlotStore::SlotPtr const&
+SlotStore::get(uint64 slotIndex) const
+{
+    static SlotPtr const none;
+    if (inWindow(slotIndex))
+    {
+        return mRing[slotIndex % CAPACITY];
+    }
+    auto it = mOverflow.find(slotIndex);
+    return it == mOverflow.end() ? none : it->second;
+}
+
+void
+SlotStore::set(uint64 slotIndex, SlotPtr slot)
+{
+    dbgAssert(slot);
+    if (empty())
+    {
+        // start the window at the first slot
+        mBase = slotIndex;
+    }
+    if (inWindow(slotIndex))
+    {
+        auto& s = mRing[slotIndex % CAPACITY];
+        if (!s)
+        {
+            mRingCount++;
+        }
+        s = std::move(slot);
+    }
+    else
+    {
+        mOverflow[slotIndex] = std::move(slot);
+    }
+}
+
+void
+SlotStore::rebase(uint64 base)
+{
+    mBase = base;
+    auto it = mOverflow.lower_bound(mBase);
+    while (it != mOverflow.end() && inWindow(it->first))
+    {
+        mRing[it->first % CAPACITY] = std::move(it->second);
+        mRingCount++;
+        it = mOverflow.erase(it);
+    }
+}
+
+void
+SlotStore::purge(uint64 maxSlotIndex)
+{
+    mOverflow.erase(mOverflow.begin(), mOverflow.lower_bound(maxSlotIndex));
+    if (maxSlotIndex <= mBase)
+    {
+        return;
+    }
+
+    for (uint64 i = mBase; mRingCount != 0 && i < maxSlotIndex && inWindow(i);
+         ++i)
+    {
+        auto& s = mRing[i % CAPACITY];
+        if (s)
+        {
+            s.reset();
+            mRingCount--;
+        }
+    }
+    // if the whole window is purged, restart it at the lowest remaining slot
+    // rather than leave the slots in the map
+    if (mRingCount == 0 && !mOverflow.empty())
+    {
+        rebase(mOverflow.begin()->first);
+    }
+    else
+    {
+        rebase(maxSlotIndex);
+    }
+}
+
+uint64
+SlotStore::getHighIndex() const
+{
+    dbgAssert(!empty());
+    if (!mOverflow.empty() && mOverflow.rbegin()->first >= mBase)
+    {
+        return mOverflow.rbegin()->first;
+    }
+    if (mRingCount != 0)
+    {
+        for (uint64 i = mBase + CAPACITY - 1;; --i)
+        {
+            if (mRing[i % CAPACITY])
+            {
+                return i;
+            }
+        }
+    }
+    return mOverflow.rbegin()->first;
+}
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "xdr/Stellar-types.h"
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace stellar
+{
+class Slot;
+
+// The slots known to an `SCP` instance, by slot index.
+//
+// Only a small window of slots above the last externalized one is active at
+// a time, so the slots of the window [mBase, mBase + CAPACITY) are kept in a
+// ring buffer indexed by `slotIndex % CAPACITY`, and the others (far-future
+// slots, or older slots that were not purged yet) in an ordered map.
+// Purging moves the window up, and the slots of the map that enter it are
+// moved to the ring.
+// Iteration is in slot index order, like the `std::map` this replaces.
+class SlotStore
+{
+  public:
+    typedef std::shared_ptr<Slot> SlotPtr;
+
+    static size_t const CAPACITY = 16;
+
+  private:
+    // slots of the window by `slotIndex % CAPACITY`, null when absent
+    std::vector<SlotPtr> mRing;
+    size_t mRingCount;
+    // lowest slot index of the window
+    uint64 mBase;
+    // slots outside of the window
+    std::map<uint64, SlotPtr> mOverflow;
+
+    bool
+    inWindow(uint64 slotIndex) const
+    {
+        return slotIndex >= mBase && slotIndex - mBase < CAPACITY;
+    }
+
+    // moves the window to start at `base`, which must not be below any slot
+    // of the ring
+    void rebase(uint64 base);
+
+  public:
+    SlotStore();
+
+    // returns the slot at `slotIndex`, null if there is none
+    SlotPtr const& get(uint64 slotIndex) const;
+
+    // stores `slot` at `slotIndex`, replacing any slot there
+    void set(uint64 slotIndex, SlotPtr slot);
+
+    // removes the slots with an index lower than `maxSlotIndex`
+    void purge(uint64 maxSlotIndex);
+
+    size_t
+    size() const
+    {
+        return mRingCount + mOverflow.size();
+    }
+
+    bool
+    empty() const
+    {
+        return size() == 0;
+    }
+
+    // returns the highest slot index, the store must not be empty
+    uint64 getHighIndex() const;
+
+    // calls `f(slotIndex, slot)` for the slots with an index of at least
+    // `from` in ascending order, until `f` returns false
+    template <typename F> void forEachAscending(uint64 from, F&& f) const;
+
+    // calls `f(slotIndex, slot)` for the slots with an index of at most
+    // `from` in descending order, until `f` returns false
+    template <typename F> void forEachDescending(uint64 from, F&& f) const;
+};
+
+template <typename F>
+void
+SlotStore::forEachAscending(uint64 from, F&& f) const
+{
+    // the slots of the map are either below or above the window
+    auto it = mOverflow.lower_bound(from);
+    for (; it != mOverflow.end() && it->first < mBase; ++it)
+    {
+        if (!f(it->first, it->second))
+        {
+            return;
+        }
+    }
+    if (mRingCount != 0)
+    {
+        for (uint64 i = std::max(from, mBase); inWindow(i); ++i)
+        {
+            auto const& slot = mRing[i % CAPACITY];
+            if (slot && !f(i, slot))
+            {
+                return;
+            }
+        }
+    }
+    for (; it != mOverflow.end(); ++it)
+    {
+        if (!f(it->first, it->second))
+        {
+            return;
+        }
+    }
+}
+
+template <typename F>
+void
+SlotStore::forEachDescending(uint64 from, F&& f) const
+{
+    auto it = mOverflow.upper_bound(from);
+    for (; it != mOverflow.begin() && std::prev(it)->first >= mBase; --it)
+    {
+        auto const& e = *std::prev(it);
+        if (!f(e.first, e.second))
+        {
+            return;
+        }
+    }
+    if (mRingCount != 0 && from >= mBase)
+    {
+        uint64 i = std::min(from, mBase + CAPACITY - 1);
+        for (;; --i)
+        {
+            auto const& slot = mRing[i % CAPACITY];
+            if (slot && !f(i, slot))
+            {
+                return;
+            }
+            if (i == mBase)
+            {
+                break;
+            }
+        }
+    }
+    for (; it != mOverflow.begin(); --it)
+    {
+        auto const& e = *std::prev(it);
+        if (!f(e.first, e.second))
+        {
+            return;
+        }
+    }
+}
+}
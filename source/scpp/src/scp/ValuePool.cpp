@@ -0,0 +1,160 @@
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "scp/ValuePool.h"
+#include "crypto/ShortHash.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace stellar
+{
+int8_t const ValuePool::NOT_VALIDATED = -1;
+
+ValuePool::ValuePool(SCPDriver& driver, SlotArena& arena)
+    : mDriver(driver)
+    , mValues(ArenaAllocator<ValueWrapperPtr>(arena))
+    , mValidationLevels(ArenaAllocator<std::array<int8_t, 2>>(arena))
+{
+}
+
+uint64
+ValuePool::hashValue(Value const& value)
+{
+    return shortHash::computeHash(ByteSlice(value.data(), value.size()));
+}
+
+bool
+ValuePool::find(Value const& value, uint64 hash, ValueID& id) const
+{
+    auto range = mIDs.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (mValues[it->second]->getValue() == value)
+        {
+            id = it->second;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+ValuePool::find(Value const& value, ValueID& id) const
+{
+    return find(value, hashValue(value), id);
+}
+
+ValuePool::ValueID
+ValuePool::intern(Value const& value)
+{
+    uint64 hash = hashValue(value);
+    ValueID id;
+    if (!find(value, hash, id))
+    {
+        id = static_cast<ValueID>(mValues.size());
+        mValues.emplace_back(mDriver.wrapValue(value, hash));
+        mValidationLevels.push_back({NOT_VALIDATED, NOT_VALIDATED});
+        mIDs.emplace(hash, id);
+    }
+    return id;
+}
+
+void
+ValuePool::setLevel(ValueID id, size_t protocol,
+                    SCPDriver::ValidationLevel level)
+{
+    if (level != SCPDriver::kInvalidValue)
+    {
+        mValidationLevels[id][protocol] = static_cast<int8_t>(level);
+    }
+}
+
+SCPDriver::ValidationLevel
+ValuePool::validate(uint64 slotIndex, Value const& value, bool nomination)
+{
+    return validate(slotIndex, intern(value), nomination);
+}
+
+SCPDriver::ValidationLevel
+ValuePool::validate(uint64 slotIndex, ValueID id, bool nomination)
+{
+    size_t protocol = nomination ? 1 : 0;
+    auto level = mValidationLevels[id][protocol];
+    if (level != NOT_VALIDATED)
+    {
+        return static_cast<SCPDriver::ValidationLevel>(level);
+    }
+    auto res = mDriver.validateValue(slotIndex, getValue(id), nomination);
+    setLevel(id, protocol, res);
+    return res;
+}
+
+void
+ValuePool::validateAll(uint64 slotIndex, std::vector<ValueID> const& ids,
+                       bool nomination,
+                       std::vector<SCPDriver::ValidationLevel>& levels)
+{
+    size_t protocol = nomination ? 1 : 0;
+    std::vector<ValueID> pending;
+    for (auto id : ids)
+    {
+        if (mValidationLevels[id][protocol] == NOT_VALIDATED)
+        {
+            pending.emplace_back(id);
+        }
+    }
+    if (!pending.empty())
+    {
+        std::sort(pending.begin(), pending.end());
+        pending.erase(std::unique(pending.begin(), pending.end()),
+                      pending.end());
+
+        std::vector<ValueWrapperPtr> values;
+        values.reserve(pending.size());
+        for (auto id : pending)
+        {
+            values.emplace_back(mValues[id]);
+        }
+        std::vector<SCPDriver::ValidationLevel> res;
+        mDriver.validateValues(slotIndex, values, nomination, res);
+        if (res.size() != pending.size())
+        {
+            throw std::runtime_error("SCPDriver::validateValues returned the "
+                                     "wrong number of levels");
+        }
+        for (size_t i = 0; i < pending.size(); i++)
+        {
+            setLevel(pending[i], protocol, res[i]);
+        }
+    }
+
+    // the levels left unknown are the invalid ones, which are not kept
+    levels.clear();
+    levels.reserve(ids.size());
+    for (auto id : ids)
+    {
+        auto level = mValidationLevels[id][protocol];
+        levels.emplace_back(level == NOT_VALIDATED
+                                ? SCPDriver::kInvalidValue
+                                : static_cast<SCPDriver::ValidationLevel>(level));
+    }
+}
+
+void
+ValuePool::invalidate(bool all)
+{
+    for (auto& levels : mValidationLevels)
+    {
+        for (auto& level : levels)
+        {
+            if (all || level == SCPDriver::kMaybeValidValue)
+            {
+                level = NOT_VALIDATED;
+            }
+        }
+    }
+}
+}
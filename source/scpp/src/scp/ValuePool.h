@@ -0,0 +1,115 @@
+#pragma once
+
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "scp/SCPDriver.h"
+#include "scp/SlotArena.h"
+
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+namespace stellar
+{
+// The values seen by a slot, each kept once in a wrapper obtained from the
+// driver, along with a hash of its content and a small integer ID.
+//
+// The protocols get their `ValueWrapperPtr`s from the pool, so that a value
+// carried by many statements is copied and wrapped only once, and the
+// structures indexed by value use IDs instead of comparing the bytes of
+// values.
+// Values are kept for the lifetime of the slot, like its statement history.
+//
+// The pool also keeps what `SCPDriver::validateValue` returned for each value
+// and protocol, so that a value is validated once per slot rather than for
+// every statement carrying it. kInvalidValue is not kept, as drivers return
+// it for values that can become valid later in the slot (for example when
+// they miss data that arrives afterwards), which would be rejected until
+// the driver invalidates them.
+class ValuePool
+{
+  public:
+    typedef uint32 ValueID;
+
+  private:
+    SCPDriver& mDriver;
+
+    // indexed by ID, allocated from the slot's arena
+    std::vector<ValueWrapperPtr, ArenaAllocator<ValueWrapperPtr>> mValues;
+    // validation level for the ballot protocol and the nomination protocol,
+    // NOT_VALIDATED if unknown or kInvalidValue
+    std::vector<std::array<int8_t, 2>, ArenaAllocator<std::array<int8_t, 2>>>
+        mValidationLevels;
+
+    static int8_t const NOT_VALIDATED;
+
+    // IDs of the values by hash
+    std::unordered_multimap<uint64, ValueID> mIDs;
+
+    static uint64 hashValue(Value const& value);
+    bool find(Value const& value, uint64 hash, ValueID& id) const;
+    void setLevel(ValueID id, size_t protocol,
+                  SCPDriver::ValidationLevel level);
+
+  public:
+    ValuePool(SCPDriver& driver, SlotArena& arena);
+
+    // returns the ID of `value`, adding it to the pool if needed
+    ValueID intern(Value const& value);
+
+    // returns true and sets `id` if `value` is in the pool
+    bool find(Value const& value, ValueID& id) const;
+
+    // returns the validation level of `value` in the slot `slotIndex`,
+    // calling `SCPDriver::validateValue` if it is not known yet
+    SCPDriver::ValidationLevel validate(uint64 slotIndex, Value const& value,
+                                        bool nomination);
+    SCPDriver::ValidationLevel validate(uint64 slotIndex, ValueID id,
+                                        bool nomination);
+
+    // validates the values of `ids` whose level for the protocol is not
+    // known yet, with a single call to `SCPDriver::validateValues`, and
+    // sets `levels` to the level of each of `ids`
+    void validateAll(uint64 slotIndex, std::vector<ValueID> const& ids,
+                     bool nomination,
+                     std::vector<SCPDriver::ValidationLevel>& levels);
+
+    // forgets the validation levels kMaybeValidValue, or all of them if
+    // `all` is set, so that the values are validated again
+    void invalidate(bool all);
+
+    // returns the shared wrapper of `value`, adding it to the pool if needed
+    ValueWrapperPtr const&
+    wrap(Value const& value)
+    {
+        return mValues[intern(value)];
+    }
+
+    ValueWrapperPtr const&
+    getWrapper(ValueID id) const
+    {
+        return mValues[id];
+    }
+
+    Value const&
+    getValue(ValueID id) const
+    {
+        return mValues[id]->getValue();
+    }
+
+    uint64
+    getHash(ValueID id) const
+    {
+        return mValues[id]->getHash();
+    }
+
+    size_t
+    size() const
+    {
+        return mValues.size();
+    }
+};
+}
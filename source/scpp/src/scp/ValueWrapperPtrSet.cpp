@@ -0,0 +1,108 @@
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "scp/ValueWrapperPtrSet.h"
+#include "scp/SCPDriver.h"
+#include "util/XDROperators.h"
+
+#include <algorithm>
+
+namespace stellar
+{
+namespace
+{
+size_t const MIN_TABLE_SIZE = 8;
+}
+
+size_t
+ValueWrapperPtrSet::findEntry(ValueWrapper const& value) const
+{
+    uint64 hash = value.getHash();
+    size_t mask = mTable.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        auto const& entry = mTable[i];
+        if (!entry.second ||
+            (entry.first == hash &&
+             (entry.second == &value ||
+              entry.second->getValue() == value.getValue())))
+        {
+            return i;
+        }
+    }
+}
+
+void
+ValueWrapperPtrSet::rehash(size_t size)
+{
+    mTable.assign(size, std::make_pair(uint64(0), nullptr));
+    for (auto const& v : mValues)
+    {
+        mTable[findEntry(*v)] = std::make_pair(v->getHash(), v.get());
+    }
+}
+
+bool
+ValueWrapperPtrSet::insert(ValueWrapperPtr const& value)
+{
+    assert(value);
+    if (contains(value))
+    {
+        return false;
+    }
+    if (2 * (mValues.size() + 1) > mTable.size())
+    {
+        rehash(std::max(MIN_TABLE_SIZE, 2 * mTable.size()));
+    }
+    mTable[findEntry(*value)] = std::make_pair(value->getHash(), value.get());
+    mValues.insert(std::lower_bound(mValues.begin(), mValues.end(), value,
+                                    WrappedValuePtrComparator()),
+                   value);
+    return true;
+}
+
+bool
+ValueWrapperPtrSet::contains(ValueWrapperPtr const& value) const
+{
+    assert(value);
+    return !mValues.empty() && mTable[findEntry(*value)].second != nullptr;
+}
+
+bool
+ValueWrapperPtrSet::erase(ValueWrapperPtr const& value)
+{
+    assert(value);
+    if (mValues.empty())
+    {
+        return false;
+    }
+    size_t i = findEntry(*value);
+    if (!mTable[i].second)
+    {
+        return false;
+    }
+    auto it = std::lower_bound(mValues.begin(), mValues.end(), value,
+                               WrappedValuePtrComparator());
+    assert(it != mValues.end() && it->get() == mTable[i].second);
+
+    // shifts back the entries after `i` that can take its place, so that
+    // lookups do not stop at a hole before reaching them
+    size_t mask = mTable.size() - 1;
+    for (size_t j = (i + 1) & mask; mTable[j].second; j = (j + 1) & mask)
+    {
+        size_t home = mTable[j].first & mask;
+        if (((j - home) & mask) >= ((j - i) & mask))
+        {
+            mTable[i] = mTable[j];
+            i = j;
+        }
+    }
+    mTable[i] = std::make_pair(uint64(0), nullptr);
+
+    // last, as `value` can be the wrapper it removes
+    mValues.erase(it);
+    return true;
+}
+}
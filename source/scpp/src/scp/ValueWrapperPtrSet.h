@@ -0,0 +1,97 @@
+#pragma once
+
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "xdr/Stellar-SCP.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace stellar
+{
+class ValueWrapper;
+typedef std::shared_ptr<ValueWrapper> ValueWrapperPtr;
+
+// A set of wrapped values, in place of a `std::set` ordered by
+// `WrappedValuePtrComparator`.
+//
+// The values are kept in a vector sorted by their bytes, so they are still
+// iterated in the order the nomination protocol and `combineCandidates`
+// depend on. Lookups go through an open addressing table of the hashes the
+// wrappers carry, so that a probe compares bytes only when hashes match,
+// instead of at every node of a tree.
+class ValueWrapperPtrSet
+{
+  public:
+    typedef std::vector<ValueWrapperPtr>::const_iterator const_iterator;
+    typedef const_iterator iterator;
+    typedef std::vector<ValueWrapperPtr>::const_reverse_iterator
+        const_reverse_iterator;
+
+  private:
+    // in ascending order of value
+    std::vector<ValueWrapperPtr> mValues;
+
+    // hash and wrapper of the values, at their hash modulo the size of the
+    // table or after it; the size is a power of 2 at least twice the number
+    // of values, and empty entries have a null wrapper
+    std::vector<std::pair<uint64, ValueWrapper const*>> mTable;
+
+    // returns the entry of `value` in the table, or the empty entry where
+    // it belongs
+    size_t findEntry(ValueWrapper const& value) const;
+    void rehash(size_t size);
+
+  public:
+    // adds `value`, returning false if the set already has a wrapper for its
+    // value
+    bool insert(ValueWrapperPtr const& value);
+
+    // returns true if the set has a wrapper for the value of `value`
+    bool contains(ValueWrapperPtr const& value) const;
+
+    // removes the wrapper for the value of `value`, returning false if the
+    // set has none
+    bool erase(ValueWrapperPtr const& value);
+
+    const_iterator
+    begin() const
+    {
+        return mValues.begin();
+    }
+
+    const_iterator
+    end() const
+    {
+        return mValues.end();
+    }
+
+    const_reverse_iterator
+    rbegin() const
+    {
+        return mValues.rbegin();
+    }
+
+    const_reverse_iterator
+    rend() const
+    {
+        return mValues.rend();
+    }
+
+    size_t
+    size() const
+    {
+        return mValues.size();
+    }
+
+    bool
+    empty() const
+    {
+        return mValues.empty();
+    }
+};
+}
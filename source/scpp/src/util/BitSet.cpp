@@ -0,0 +1,104 @@
+// Copyright 2021 BOSAGORA Foundation and contributors. Licensed
+// under the Apache License, Version 2.0. See the COPYING file at the root
+// of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
+// Not originally part of SCP
+
+#include "util/BitSet.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#define BITSET_DISPATCH_POPCNT 1
+#endif
+
+namespace
+{
+struct Self
+{
+    uint64_t
+    operator()(uint64_t a, uint64_t) const
+    {
+        return a;
+    }
+};
+struct Union
+{
+    uint64_t
+    operator()(uint64_t a, uint64_t b) const
+    {
+        return a | b;
+    }
+};
+struct Intersection
+{
+    uint64_t
+    operator()(uint64_t a, uint64_t b) const
+    {
+        return a & b;
+    }
+};
+struct Difference
+{
+    uint64_t
+    operator()(uint64_t a, uint64_t b) const
+    {
+        return a & ~b;
+    }
+};
+struct SymmetricDifference
+{
+    uint64_t
+    operator()(uint64_t a, uint64_t b) const
+    {
+        return a ^ b;
+    }
+};
+
+// The same loop is compiled for the baseline CPU, where the popcount builtin
+// is a bit-twiddling sequence or a library call, and for CPUs with POPCNT.
+#define BITSET_COUNT_KERNEL_BODY                                               \
+    Op op;                                                                     \
+    size_t res = 0;                                                            \
+    for (size_t i = 0; i < NWORDS; ++i)                                        \
+    {                                                                          \
+        res += __builtin_popcountll(op(a[i], b[i]));                           \
+    }                                                                          \
+    return res;
+
+template <size_t NWORDS, typename Op>
+size_t
+countWords(uint64_t const* a, uint64_t const* b)
+{
+    BITSET_COUNT_KERNEL_BODY
+}
+
+#ifdef BITSET_DISPATCH_POPCNT
+template <size_t NWORDS, typename Op>
+__attribute__((target("popcnt"))) size_t
+countWordsPopcnt(uint64_t const* a, uint64_t const* b)
+{
+    BITSET_COUNT_KERNEL_BODY
+}
+#endif
+}
+
+BitSet::CountKernels
+BitSet::selectCountKernels()
+{
+#ifdef BITSET_DISPATCH_POPCNT
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("popcnt"))
+    {
+        return CountKernels{
+            countWordsPopcnt<INLINE_NWORDS, Self>,
+            countWordsPopcnt<INLINE_NWORDS, Union>,
+            countWordsPopcnt<INLINE_NWORDS, Intersection>,
+            countWordsPopcnt<INLINE_NWORDS, Difference>,
+            countWordsPopcnt<INLINE_NWORDS, SymmetricDifference>};
+    }
+#endif
+    return CountKernels{countWords<INLINE_NWORDS, Self>,
+                        countWords<INLINE_NWORDS, Union>,
+                        countWords<INLINE_NWORDS, Intersection>,
+                        countWords<INLINE_NWORDS, Difference>,
+                        countWords<INLINE_NWORDS, SymmetricDifference>};
+}
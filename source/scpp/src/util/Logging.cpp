@@ -2,6 +2,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include <atomic>
 #include <cstdarg>
 #include <iostream>
 #include <vector>
@@ -11,6 +12,53 @@ using namespace std;
 
 namespace stellar
 {
+namespace
+{
+struct CachedLevel
+{
+    // partitions are usually string literals, compared by address first
+    char const* mAddress;
+    std::string mPartition;
+    int mLevel;
+};
+
+// The levels of the loggers are thread-local on the D side
+struct LevelCache
+{
+    uint64_t mVersion = 0;
+    std::vector<CachedLevel> mLevels;
+};
+
+thread_local LevelCache gLevelCache;
+}
+
+int
+Logging::getLevel(char const* partition)
+{
+    static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+                  "the version is a plain integer on the D side");
+    static auto const* version = reinterpret_cast<std::atomic<uint64_t> const*>(
+        agora::getLogLevelsVersion());
+
+    auto& cache = gLevelCache;
+    auto current = version->load(std::memory_order_relaxed);
+    if (cache.mVersion != current)
+    {
+        cache.mLevels.clear();
+        cache.mVersion = current;
+    }
+    for (auto const& l : cache.mLevels)
+    {
+        if (l.mAddress == partition || l.mPartition == partition)
+        {
+            return l.mLevel;
+        }
+    }
+    int level = agora::getLogLevel(partition);
+    cache.mLevels.push_back(CachedLevel{partition, partition, level});
+    return level;
+}
+
 DLogger::DLogger(int level, std::string const& loggerName)
 {
     mLevel = level;
@@ -4,6 +4,7 @@
 // under the Apache License, Version 2.0. See the COPYING file at the root
 // of this distribution or at http://www.apache.org/licenses/LICENSE-2.0
 
+#include <cstdint>
 #include <string>
 #include <sstream>
 #include <iostream>
@@ -14,12 +15,19 @@
 #define WARN  4
 #define ERROR 5
 #define FATAL 6
-#define CLOG(LEVEL, MOD) stellar::DLogger(LEVEL, MOD)
+// The operands of a disabled log statement are not evaluated
+#define CLOG(LEVEL, MOD)                                                      \
+    !stellar::Logging::isEnabled(LEVEL, MOD)                                   \
+        ? (void)0                                                              \
+        : stellar::LogVoidify() & stellar::DLogger(LEVEL, MOD)
 
 namespace agora {
     // Exposed in `agora.utils.Log`
     void writeDLog(const char* logger, int level, const char* msg);
     int getLogLevel (const char* logger);
+    // Version of the levels of the loggers, incremented by D whenever
+    // a level changes
+    const uint64_t* getLogLevelsVersion ();
 };
 
 namespace stellar
@@ -30,13 +38,20 @@ class Logging
     static void init();
     static void setFmt(std::string const& peerID, bool timestamps = true);
     static void setLoggingToFile(std::string const& filename);
-    static bool logDebug(std::string const& partition)
+    // Returns the level of `partition`, cached per thread until D changes
+    // the configuration of the loggers
+    static int getLevel(char const* partition);
+    static bool isEnabled(int level, char const* partition)
     {
-        return agora::getLogLevel(partition.c_str()) <= DEBUG;
+        return getLevel(partition) <= level;
     }
-    static bool logTrace(std::string const& partition)
+    static bool logDebug(char const* partition)
     {
-        return agora::getLogLevel(partition.c_str()) <= TRACE;
+        return isEnabled(DEBUG, partition);
+    }
+    static bool logTrace(char const* partition)
+    {
+        return isEnabled(TRACE, partition);
     }
     static void rotate();
 };
@@ -59,4 +74,13 @@ struct DLogger
         return *this;
     }
 };
+
+// Gives a log statement the type `void`, for both branches of `CLOG`.
+// `&` binds less tightly than `<<` but more than `?:`.
+struct LogVoidify
+{
+    void operator&(DLogger const&)
+    {
+    }
+};
 }
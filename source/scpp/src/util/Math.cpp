@@ -13,7 +13,7 @@
 namespace stellar
 {
 
-stellar_default_random_engine gRandomEngine;
+thread_local stellar_default_random_engine gRandomEngine;
 std::uniform_real_distribution<double> uniformFractionDistribution(0.0, 1.0);
 
 double
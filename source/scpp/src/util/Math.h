@@ -21,7 +21,8 @@ bool rand_flip();
 
 typedef std::minstd_rand stellar_default_random_engine;
 
-extern stellar_default_random_engine gRandomEngine;
+// one per thread, so that the helpers below can be used from any thread
+extern thread_local stellar_default_random_engine gRandomEngine;
 
 template <typename T>
 T